@@ -0,0 +1,69 @@
+// Batched matmul on cooperative matrices (tensor cores / WMMA): fp16 A and B, fp32 accumulation.
+// Each workgroup is one subgroup computing an (RM * TILE_M) x (RN * TILE_N) block of C as RM x RN
+// accumulator fragments, so every A fragment loaded is used RN times and every B fragment RM
+// times. The host pads M, N and K to multiples of the block and tile sizes, so fragments never
+// reach past the matrices.
+//
+// The including shader defines the fragment types MAT_A, MAT_B and MAT_C and the operations
+// LOAD(mat, buffer, offset, stride), MUL_ADD(a, b, c) and STORE(mat, buffer, offset, stride) for
+// its extension; offsets and strides are in elements of row-major matrices.
+
+layout(constant_id = 0) const uint SUBGROUP_SIZE = 32;
+layout(constant_id = 1) const uint TILE_M = 16;  // device cooperative matrix shape
+layout(constant_id = 2) const uint TILE_N = 16;
+layout(constant_id = 3) const uint TILE_K = 16;
+layout(constant_id = 4) const uint RM = 2;  // fragments per subgroup along M
+layout(constant_id = 5) const uint RN = 2;  // fragments per subgroup along N
+
+layout(local_size_x_id = 0, local_size_y = 1, local_size_z = 1) in;
+
+// Padded dimensions
+layout(push_constant) uniform Params {
+    MatrixParams p;
+} params;
+
+layout(set = 0, binding = 0) readonly buffer BufferA {
+    float16_t data[];
+} A;
+
+layout(set = 0, binding = 1) readonly buffer BufferB {
+    float16_t data[];
+} B;
+
+layout(set = 0, binding = 2) writeonly buffer BufferC {
+    float data[];
+} C;
+
+void main() {
+    uint batch_idx = gl_WorkGroupID.z;
+    uint row_base = gl_WorkGroupID.y * RM * TILE_M;
+    uint col_base = gl_WorkGroupID.x * RN * TILE_N;
+    uint m = params.p.m;
+    uint k = params.p.k;
+    uint n = params.p.n;
+    if (batch_idx >= params.p.batch || row_base >= m || col_base >= n) return;
+
+    MAT_C acc[RM * RN];
+    for (uint i = 0; i < RM * RN; ++i) acc[i] = MAT_C(0.0);
+
+    for (uint k0 = 0; k0 < k; k0 += TILE_K) {
+        MAT_A a[RM];
+        MAT_B b[RN];
+        for (uint i = 0; i < RM; ++i) {
+            LOAD(a[i], GET_DATA(A), IX3D(batch_idx, row_base + i * TILE_M, k0, m, k), k);
+        }
+        for (uint j = 0; j < RN; ++j) {
+            LOAD(b[j], GET_DATA(B), IX3D(batch_idx, k0, col_base + j * TILE_N, k, n), n);
+        }
+        for (uint i = 0; i < RM; ++i) {
+            for (uint j = 0; j < RN; ++j) acc[i * RN + j] = MUL_ADD(a[i], b[j], acc[i * RN + j]);
+        }
+    }
+
+    for (uint i = 0; i < RM; ++i) {
+        for (uint j = 0; j < RN; ++j) {
+            uint offset = IX3D(batch_idx, row_base + i * TILE_M, col_base + j * TILE_N, m, n);
+            STORE(acc[i * RN + j], GET_DATA(C), offset, n);
+        }
+    }
+}
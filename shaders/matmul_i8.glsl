@@ -0,0 +1,109 @@
+// Tiled batched matmul over int8 inputs with int32 accumulation and output. Sums wrap modulo 2^32
+// like the CPU reference, so results are exact for any K in that ring. A and B are 32-bit words
+// holding four int8 each (element i in byte i % 4). The shared tiles repack both along K, four
+// values per word, so the inner loop is one 4-way dot product per word pair.
+//
+// The including shader defines int dot4(uint a, uint b), the signed dot product of the four bytes
+// of a and b. BK must be a multiple of 4.
+
+layout(constant_id = 0) const uint WG_X = 16;  // invocations along N
+layout(constant_id = 1) const uint WG_Y = 16;  // invocations along M
+layout(constant_id = 2) const uint TM = 4;     // rows per invocation
+layout(constant_id = 3) const uint TN = 4;     // columns per invocation
+layout(constant_id = 4) const uint BK = 16;    // K depth of a shared tile
+
+layout(local_size_x_id = 0, local_size_y_id = 1, local_size_z = 1) in;
+
+const uint BM = WG_Y * TM;
+const uint BN = WG_X * TN;
+const uint BKW = BK / 4;  // words along K in a shared tile
+
+layout(push_constant) uniform Params {
+    MatrixParams p;
+} params;
+
+layout(set = 0, binding = 0) readonly buffer BufferA {
+    uint data[];
+} A;
+
+layout(set = 0, binding = 1) readonly buffer BufferB {
+    uint data[];
+} B;
+
+layout(set = 0, binding = 2) writeonly buffer BufferC {
+    int data[];
+} C;
+
+shared uint tileA[BM * BKW];  // [row][k word]
+shared uint tileB[BKW * BN];  // [k word][column]
+
+uint load_byte_a(uint i) {
+    return bitfieldExtract(GET_DATA(A)[i >> 2], int((i & 3u) * 8u), 8);
+}
+
+uint load_byte_b(uint i) {
+    return bitfieldExtract(GET_DATA(B)[i >> 2], int((i & 3u) * 8u), 8);
+}
+
+void main() {
+    uint batch_idx = gl_WorkGroupID.z;
+    uint row_base = gl_WorkGroupID.y * BM;
+    uint col_base = gl_WorkGroupID.x * BN;
+    uint tx = gl_LocalInvocationID.x;
+    uint ty = gl_LocalInvocationID.y;
+    uint tid = ty * WG_X + tx;
+    uint num_threads = WG_X * WG_Y;
+
+    int acc[TM * TN];
+    for (uint i = 0; i < TM * TN; ++i) acc[i] = 0;
+
+    for (uint k0 = 0; k0 < params.p.k; k0 += BK) {
+        for (uint i = tid; i < BM * BKW; i += num_threads) {
+            uint r = row_base + i / BKW;
+            uint c = k0 + (i % BKW) * 4u;
+            uint word = 0u;
+            for (uint j = 0; j < 4u; ++j) {
+                if (r < params.p.m && c + j < params.p.k) {
+                    uint v = load_byte_a(IX3D(batch_idx, r, c + j, params.p.m, params.p.k));
+                    word = bitfieldInsert(word, v, int(j * 8u), 8);
+                }
+            }
+            tileA[i] = word;
+        }
+        for (uint i = tid; i < BKW * BN; i += num_threads) {
+            uint r = k0 + (i / BN) * 4u;
+            uint c = col_base + i % BN;
+            uint word = 0u;
+            for (uint j = 0; j < 4u; ++j) {
+                if (r + j < params.p.k && c < params.p.n) {
+                    uint v = load_byte_b(IX3D(batch_idx, r + j, c, params.p.k, params.p.n));
+                    word = bitfieldInsert(word, v, int(j * 8u), 8);
+                }
+            }
+            tileB[i] = word;
+        }
+        barrier();
+
+        for (uint kw = 0; kw < BKW; ++kw) {
+            uint a[TM];
+            uint b[TN];
+            for (uint i = 0; i < TM; ++i) a[i] = tileA[(ty * TM + i) * BKW + kw];
+            for (uint j = 0; j < TN; ++j) b[j] = tileB[kw * BN + tx + j * WG_X];
+            for (uint i = 0; i < TM; ++i) {
+                for (uint j = 0; j < TN; ++j) acc[i * TN + j] += dot4(a[i], b[j]);
+            }
+        }
+        barrier();
+    }
+
+    if (batch_idx >= params.p.batch) return;
+    for (uint i = 0; i < TM; ++i) {
+        uint row = row_base + ty * TM + i;
+        for (uint j = 0; j < TN; ++j) {
+            uint col = col_base + tx + j * WG_X;
+            if (row < params.p.m && col < params.p.n) {
+                GET_DATA(C)[IX3D(batch_idx, row, col, params.p.m, params.p.n)] = acc[i * TN + j];
+            }
+        }
+    }
+}
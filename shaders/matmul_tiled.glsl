@@ -0,0 +1,82 @@
+// Tiled batched matmul accumulating in fp32. Each workgroup computes a BM x BN block of C, staging
+// BM x BK tiles of A and BK x BN tiles of B in shared memory. Each invocation accumulates a TM x TN
+// register block, with its columns strided by WG_X so neighbouring invocations touch neighbouring
+// addresses.
+//
+// The including shader declares buffers A (binding 0) and B (binding 1) and defines LOAD_A(i) and
+// LOAD_B(i), element i of each as a float, so the storage type is its choice.
+
+layout(constant_id = 0) const uint WG_X = 16;  // invocations along N
+layout(constant_id = 1) const uint WG_Y = 16;  // invocations along M
+layout(constant_id = 2) const uint TM = 4;     // rows per invocation
+layout(constant_id = 3) const uint TN = 4;     // columns per invocation
+layout(constant_id = 4) const uint BK = 16;    // K depth of a shared tile
+
+layout(local_size_x_id = 0, local_size_y_id = 1, local_size_z = 1) in;
+
+const uint BM = WG_Y * TM;
+const uint BN = WG_X * TN;
+
+layout(push_constant) uniform Params {
+    MatrixParams p;
+} params;
+
+layout(set = 0, binding = 2) writeonly buffer BufferC {
+    float data[];
+} C;
+
+shared float tileA[BM * BK];
+shared float tileB[BK * BN];
+
+void main() {
+    uint batch_idx = gl_WorkGroupID.z;
+    uint row_base = gl_WorkGroupID.y * BM;
+    uint col_base = gl_WorkGroupID.x * BN;
+    uint tx = gl_LocalInvocationID.x;
+    uint ty = gl_LocalInvocationID.y;
+    uint tid = ty * WG_X + tx;
+    uint num_threads = WG_X * WG_Y;
+
+    float acc[TM * TN];
+    for (uint i = 0; i < TM * TN; ++i) acc[i] = 0.0;
+
+    for (uint k0 = 0; k0 < params.p.k; k0 += BK) {
+        for (uint i = tid; i < BM * BK; i += num_threads) {
+            uint r = row_base + i / BK;
+            uint c = k0 + i % BK;
+            tileA[i] = (r < params.p.m && c < params.p.k)
+                           ? LOAD_A(IX3D(batch_idx, r, c, params.p.m, params.p.k))
+                           : 0.0;
+        }
+        for (uint i = tid; i < BK * BN; i += num_threads) {
+            uint r = k0 + i / BN;
+            uint c = col_base + i % BN;
+            tileB[i] = (r < params.p.k && c < params.p.n)
+                           ? LOAD_B(IX3D(batch_idx, r, c, params.p.k, params.p.n))
+                           : 0.0;
+        }
+        barrier();
+
+        for (uint kk = 0; kk < BK; ++kk) {
+            float a[TM];
+            float b[TN];
+            for (uint i = 0; i < TM; ++i) a[i] = tileA[(ty * TM + i) * BK + kk];
+            for (uint j = 0; j < TN; ++j) b[j] = tileB[kk * BN + tx + j * WG_X];
+            for (uint i = 0; i < TM; ++i) {
+                for (uint j = 0; j < TN; ++j) acc[i * TN + j] += a[i] * b[j];
+            }
+        }
+        barrier();
+    }
+
+    if (batch_idx >= params.p.batch) return;
+    for (uint i = 0; i < TM; ++i) {
+        uint row = row_base + ty * TM + i;
+        for (uint j = 0; j < TN; ++j) {
+            uint col = col_base + tx + j * WG_X;
+            if (row < params.p.m && col < params.p.n) {
+                GET_DATA(C)[IX3D(batch_idx, row, col, params.p.m, params.p.n)] = acc[i * TN + j];
+            }
+        }
+    }
+}
@@ -0,0 +1,118 @@
+// Sort stages of the bucket method: group the points of every (MSM, window) by the bucket their
+// signed digit selects, so bucket accumulation reads just its own points instead of scanning
+// every scalar. A counting sort by bucket id in three passes after clearing the counts:
+//   count    histogram of bucket ids, one atomic add per (point, window)
+//   prefix   exclusive prefix sum of each (MSM, window) histogram into start offsets
+//   scatter  place each point at its bucket's next free slot, advancing the offset
+// Afterwards offset b holds the end of bucket b's entries, which start at offset b - 1 (0 for
+// b = 0). Entry order within a bucket depends on atomic ordering, which a sum does not notice.
+// Digits are recomputed from the scalars in scatter rather than stored: two scalar words are
+// cheaper to read than a word per (point, window).
+//
+// The including shader declares `push.params` (MsmParams), `scalars[]` (blst_scalar words,
+// [msm][point]) and `bucket_lists[]`: batch * num_windows * num_buckets offsets followed by
+// batch * num_windows * points entries.
+
+uint bucket_offsets_index(uint m, uint w) {
+    uint num_buckets = msm_num_buckets(push.params.window_bits);
+    return (m * push.params.num_windows + w) * num_buckets;
+}
+
+uint bucket_entries_index(uint m, uint w) {
+    uint num_buckets = msm_num_buckets(push.params.window_bits);
+    uint offsets = push.params.batch * push.params.num_windows * num_buckets;
+    return offsets + (m * push.params.num_windows + w) * push.params.points;
+}
+
+// Index of this invocation in a 1D range the host spread over rows of a 2D grid (MsmPlan::grid)
+uint msm_sort_invocation() {
+    return gl_GlobalInvocationID.y * gl_NumWorkGroups.x * gl_WorkGroupSize.x +
+           gl_GlobalInvocationID.x;
+}
+
+// Signed digit of window w of scalar i of MSM m
+int scalar_digit(uint i, uint w, uint m) {
+    uint c = push.params.window_bits;
+    uint first = (m * push.params.points + i) * MSM_SCALAR_WORDS;
+    uint bits;
+    if (w == 0u) {
+        bits = scalars[first] << 1;
+    } else {
+        uint bit = w * c - 1u;
+        uint word = bit >> 5;
+        uint shift = bit & 31u;
+        bits = scalars[first + word] >> shift;
+        if (shift + c + 1u > 32u && word + 1u < MSM_SCALAR_WORDS) {
+            bits |= scalars[first + word + 1u] << (32u - shift);
+        }
+    }
+    return msm_booth_digit(bits & ((2u << c) - 1u), c);
+}
+
+// One invocation per offset of every (MSM, window)
+void clear_bucket_offsets() {
+    uint i = msm_sort_invocation();
+    uint count = push.params.batch * push.params.num_windows *
+                 msm_num_buckets(push.params.window_bits);
+    if (i < count) bucket_lists[i] = 0u;
+}
+
+// One invocation per (point, window, MSM), z selecting the (MSM, window)
+void count_bucket_sizes() {
+    uint i = msm_sort_invocation();
+    uint w = gl_GlobalInvocationID.z % push.params.num_windows;
+    uint m = gl_GlobalInvocationID.z / push.params.num_windows;
+    if (i >= push.params.points || m >= push.params.batch) return;
+
+    int digit = scalar_digit(i, w, m);
+    if (digit != 0) atomicAdd(bucket_lists[bucket_offsets_index(m, w) + uint(abs(digit)) - 1u], 1u);
+}
+
+// One invocation per (window, MSM): bucket counts are at most 2^(c-1) per window, few enough for
+// a serial scan
+void prefix_bucket_offsets() {
+    uint w = gl_GlobalInvocationID.x;
+    uint m = gl_GlobalInvocationID.y;
+    if (w >= push.params.num_windows || m >= push.params.batch) return;
+
+    uint first = bucket_offsets_index(m, w);
+    uint num_buckets = msm_num_buckets(push.params.window_bits);
+    uint sum = 0u;
+    for (uint b = 0; b < num_buckets; ++b) {
+        uint count = bucket_lists[first + b];
+        bucket_lists[first + b] = sum;
+        sum += count;
+    }
+}
+
+// One invocation per (point, window, MSM), z selecting the (MSM, window)
+void scatter_bucket_entries() {
+    uint i = msm_sort_invocation();
+    uint w = gl_GlobalInvocationID.z % push.params.num_windows;
+    uint m = gl_GlobalInvocationID.z / push.params.num_windows;
+    if (i >= push.params.points || m >= push.params.batch) return;
+
+    int digit = scalar_digit(i, w, m);
+    if (digit == 0) return;
+    uint b = uint(abs(digit)) - 1u;
+    uint slot = atomicAdd(bucket_lists[bucket_offsets_index(m, w) + b], 1u);
+    bucket_lists[bucket_entries_index(m, w) + slot] = i | (digit < 0 ? MSM_NEGATE_BIT : 0u);
+}
+
+// Run sort stage `stage` (MSM_STAGE_CLEAR .. MSM_STAGE_SCATTER)
+void run_sort_stage(uint stage) {
+    switch (stage) {
+        case MSM_STAGE_CLEAR:
+            clear_bucket_offsets();
+            break;
+        case MSM_STAGE_COUNT:
+            count_bucket_sizes();
+            break;
+        case MSM_STAGE_PREFIX:
+            prefix_bucket_offsets();
+            break;
+        case MSM_STAGE_SCATTER:
+            scatter_bucket_entries();
+            break;
+    }
+}
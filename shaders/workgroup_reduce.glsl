@@ -0,0 +1,64 @@
+// Sum of one value per invocation over a whole workgroup.
+//
+// Built with REDUCE_SUBGROUP defined (Vulkan 1.1 SPIR-V, on devices whose compute stage has the
+// needed subgroup operations), each subgroup first reduces in registers: with
+// REDUCE_SUBGROUP_ADD(v) when the type is one subgroupAdd() takes, otherwise with a butterfly of
+// REDUCE_SHUFFLE_XOR(v, mask) exchanges. Only one value per subgroup then passes through shared
+// memory. Without REDUCE_SUBGROUP the whole reduction is a tree in shared memory.
+//
+// The including shader defines REDUCE_T, REDUCE_ADD(a, b) and REDUCE_WORKGROUP_SIZE, a power of
+// two equal to its local size, before including this file. workgroup_reduce() contains barriers,
+// so every invocation of the workgroup must call it.
+
+#ifdef REDUCE_SUBGROUP
+#extension GL_KHR_shader_subgroup_basic : require
+#ifdef REDUCE_SUBGROUP_ADD
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#else
+#extension GL_KHR_shader_subgroup_shuffle : require
+#endif
+#endif
+
+shared REDUCE_T reduce_scratch[REDUCE_WORKGROUP_SIZE];
+
+#ifdef REDUCE_SUBGROUP
+// Sum over the invocations of this subgroup, returned to all of them. A subgroup wider than the
+// workgroup has only its first REDUCE_WORKGROUP_SIZE invocations active, so the butterfly stays
+// within those.
+REDUCE_T subgroup_reduce(REDUCE_T v) {
+#ifdef REDUCE_SUBGROUP_ADD
+    return REDUCE_SUBGROUP_ADD(v);
+#else
+    for (uint mask = min(gl_SubgroupSize, REDUCE_WORKGROUP_SIZE) >> 1; mask > 0u; mask >>= 1) {
+        v = REDUCE_ADD(v, REDUCE_SHUFFLE_XOR(v, mask));
+    }
+    return v;
+#endif
+}
+#endif
+
+// Sum of `v` over the workgroup, valid in invocation 0
+REDUCE_T workgroup_reduce(REDUCE_T v) {
+#ifdef REDUCE_SUBGROUP
+    v = subgroup_reduce(v);
+    if (gl_NumSubgroups == 1u) return v;
+    if (subgroupElect()) reduce_scratch[gl_SubgroupID] = v;
+    barrier();
+    // Invocation 0 already holds the sum of subgroup 0; few enough subgroups remain to add serially
+    if (gl_LocalInvocationIndex == 0u) {
+        for (uint i = 1u; i < gl_NumSubgroups; ++i) v = REDUCE_ADD(v, reduce_scratch[i]);
+    }
+    return v;
+#else
+    uint i = gl_LocalInvocationIndex;
+    reduce_scratch[i] = v;
+    barrier();
+    for (uint stride = REDUCE_WORKGROUP_SIZE >> 1; stride > 0u; stride >>= 1) {
+        if (i < stride) {
+            reduce_scratch[i] = REDUCE_ADD(reduce_scratch[i], reduce_scratch[i + stride]);
+        }
+        barrier();
+    }
+    return reduce_scratch[0];
+#endif
+}
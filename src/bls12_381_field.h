@@ -0,0 +1,305 @@
+// BLS12-381 base field (Fp) and scalar field (Fr) arithmetic shared between the compute shaders
+// and the host, which compiles the same source as C++ to check it against blst without a GPU.
+//
+// Elements are little-endian 32-bit limbs in Montgomery form (R = 2^384 for Fp, 2^256 for Fr),
+// bit-identical to blst's 64-bit limb blst_fp/blst_fr on little-endian hosts. Every operation
+// takes and returns fully reduced values, so results compare equal to blst's byte for byte.
+#ifndef BLS12_381_FIELD_H
+#define BLS12_381_FIELD_H
+
+#include "common.h"
+
+#ifdef __cplusplus
+// The GLSL integer builtins the arithmetic below is written in
+SHARED_FN uint uaddCarry(uint a, uint b, uint& carry) {
+    uint r = a + b;
+    carry = r < a ? 1u : 0u;
+    return r;
+}
+
+SHARED_FN uint usubBorrow(uint a, uint b, uint& borrow) {
+    borrow = a < b ? 1u : 0u;
+    return a - b;
+}
+
+SHARED_FN void umulExtended(uint a, uint b, uint& hi, uint& lo) {
+    uint64_t p = uint64_t(a) * b;
+    hi = uint(p >> 32);
+    lo = uint(p);
+}
+#endif
+
+#define FP_LIMBS 12
+#define FR_LIMBS 8
+
+struct Fp {
+    uint l[FP_LIMBS];
+};
+
+struct Fr {
+    uint l[FR_LIMBS];
+};
+
+const uint FP_MODULUS[FP_LIMBS] = SHARED_ARRAY_BEGIN(uint, FP_LIMBS)
+    0xffffaaabu, 0xb9feffffu, 0xb153ffffu, 0x1eabfffeu, 0xf6b0f624u, 0x6730d2a0u,
+    0xf38512bfu, 0x64774b84u, 0x434bacd7u, 0x4b1ba7b6u, 0x397fe69au, 0x1a0111eau SHARED_ARRAY_END;
+
+// R mod p, i.e. 1 in Montgomery form
+const uint FP_ONE[FP_LIMBS] = SHARED_ARRAY_BEGIN(uint, FP_LIMBS)
+    0x0002fffdu, 0x76090000u, 0xc40c0002u, 0xebf4000bu, 0x53c758bau, 0x5f489857u,
+    0x70525745u, 0x77ce5853u, 0xa256ec6du, 0x5c071a97u, 0xfa80e493u, 0x15f65ec3u SHARED_ARRAY_END;
+
+// R^2 mod p: fp_mul by it takes a plain value to Montgomery form
+const uint FP_R2[FP_LIMBS] = SHARED_ARRAY_BEGIN(uint, FP_LIMBS)
+    0x1c341746u, 0xf4df1f34u, 0x09d104f1u, 0x0a76e6a6u, 0x4c95b6d5u, 0x8de5476cu,
+    0x939d83c0u, 0x67eb88a9u, 0xb519952du, 0x9a793e85u, 0x92cae3aau, 0x11988fe5u SHARED_ARRAY_END;
+
+// (p + 1) / 4: p = 3 mod 4, so a^((p + 1) / 4) is a square root of a whenever a has one
+const uint FP_SQRT_EXPONENT[FP_LIMBS] = SHARED_ARRAY_BEGIN(uint, FP_LIMBS)
+    0xffffeaabu, 0xee7fbfffu, 0xac54ffffu, 0x07aaffffu, 0x3dac3d89u, 0xd9cc34a8u,
+    0x3ce144afu, 0xd91dd2e1u, 0x90d2eb35u, 0x92c6e9edu, 0x8e5ff9a6u, 0x0680447au SHARED_ARRAY_END;
+
+// -p^-1 mod 2^32
+const uint FP_INV = 0xfffcfffdu;
+
+const uint FR_MODULUS[FR_LIMBS] = SHARED_ARRAY_BEGIN(uint, FR_LIMBS)
+    0x00000001u, 0xffffffffu, 0xfffe5bfeu, 0x53bda402u, 0x09a1d805u, 0x3339d808u, 0x299d7d48u,
+    0x73eda753u SHARED_ARRAY_END;
+
+// -r^-1 mod 2^32
+const uint FR_INV = 0xffffffffu;
+
+// (hi, lo) = a * b + c + d, which cannot overflow 64 bits
+SHARED_FN void mac(uint a, uint b, uint c, uint d, SHARED_OUT(uint) hi, SHARED_OUT(uint) lo) {
+    uint h, l, carry;
+    umulExtended(a, b, h, l);
+    l = uaddCarry(l, c, carry);
+    h += carry;
+    l = uaddCarry(l, d, carry);
+    h += carry;
+    hi = h;
+    lo = l;
+}
+
+SHARED_FN Fp fp_zero() {
+    Fp r;
+    for (uint i = 0; i < FP_LIMBS; ++i) r.l[i] = 0u;
+    return r;
+}
+
+SHARED_FN Fp fp_one() {
+    Fp r;
+    for (uint i = 0; i < FP_LIMBS; ++i) r.l[i] = FP_ONE[i];
+    return r;
+}
+
+SHARED_FN bool fp_is_zero(Fp a) {
+    uint acc = 0u;
+    for (uint i = 0; i < FP_LIMBS; ++i) acc |= a.l[i];
+    return acc == 0u;
+}
+
+SHARED_FN bool fp_eq(Fp a, Fp b) {
+    uint acc = 0u;
+    for (uint i = 0; i < FP_LIMBS; ++i) acc |= a.l[i] ^ b.l[i];
+    return acc == 0u;
+}
+
+// r = a - p if a >= p (a < 2p, with `hi` the carry out of the top limb)
+SHARED_FN Fp fp_reduce_once(Fp a, uint hi) {
+    Fp r;
+    uint borrow = 0u;
+    for (uint i = 0; i < FP_LIMBS; ++i) {
+        uint b0, b1;
+        uint d = usubBorrow(a.l[i], FP_MODULUS[i], b0);
+        r.l[i] = usubBorrow(d, borrow, b1);
+        borrow = b0 | b1;
+    }
+    // Keep a when a < p, i.e. the subtraction borrowed and there was no carry in
+    return (borrow > hi) ? a : r;
+}
+
+SHARED_FN Fp fp_add(Fp a, Fp b) {
+    Fp r;
+    uint carry = 0u;
+    for (uint i = 0; i < FP_LIMBS; ++i) {
+        uint c0, c1;
+        uint s = uaddCarry(a.l[i], b.l[i], c0);
+        r.l[i] = uaddCarry(s, carry, c1);
+        carry = c0 | c1;
+    }
+    return fp_reduce_once(r, carry);
+}
+
+SHARED_FN Fp fp_sub(Fp a, Fp b) {
+    Fp r;
+    uint borrow = 0u;
+    for (uint i = 0; i < FP_LIMBS; ++i) {
+        uint b0, b1;
+        uint d = usubBorrow(a.l[i], b.l[i], b0);
+        r.l[i] = usubBorrow(d, borrow, b1);
+        borrow = b0 | b1;
+    }
+    if (borrow != 0u) {
+        uint carry = 0u;
+        for (uint i = 0; i < FP_LIMBS; ++i) {
+            uint c0, c1;
+            uint s = uaddCarry(r.l[i], FP_MODULUS[i], c0);
+            r.l[i] = uaddCarry(s, carry, c1);
+            carry = c0 | c1;
+        }
+    }
+    return r;
+}
+
+SHARED_FN Fp fp_dbl(Fp a) {
+    return fp_add(a, a);
+}
+
+// Montgomery multiplication a * b * R^-1 mod p (CIOS)
+SHARED_FN Fp fp_mul(Fp a, Fp b) {
+    uint t[FP_LIMBS + 2];
+    for (uint i = 0; i < FP_LIMBS + 2; ++i) t[i] = 0u;
+
+    for (uint i = 0; i < FP_LIMBS; ++i) {
+        uint c = 0u;
+        for (uint j = 0; j < FP_LIMBS; ++j) mac(a.l[j], b.l[i], t[j], c, c, t[j]);
+        uint carry;
+        t[FP_LIMBS] = uaddCarry(t[FP_LIMBS], c, carry);
+        t[FP_LIMBS + 1] = carry;
+
+        uint m = t[0] * FP_INV;
+        uint lo;
+        mac(m, FP_MODULUS[0], t[0], 0u, c, lo);
+        for (uint j = 1; j < FP_LIMBS; ++j) mac(m, FP_MODULUS[j], t[j], c, c, t[j - 1]);
+        t[FP_LIMBS - 1] = uaddCarry(t[FP_LIMBS], c, carry);
+        t[FP_LIMBS] = t[FP_LIMBS + 1] + carry;
+    }
+
+    Fp r;
+    for (uint i = 0; i < FP_LIMBS; ++i) r.l[i] = t[i];
+    return fp_reduce_once(r, t[FP_LIMBS]);
+}
+
+SHARED_FN Fp fp_sqr(Fp a) {
+    return fp_mul(a, a);
+}
+
+SHARED_FN Fp fp_to_montgomery(Fp a) {
+    Fp r2;
+    for (uint i = 0; i < FP_LIMBS; ++i) r2.l[i] = FP_R2[i];
+    return fp_mul(a, r2);
+}
+
+SHARED_FN Fp fp_from_montgomery(Fp a) {
+    Fp one = fp_zero();
+    one.l[0] = 1u;
+    return fp_mul(a, one);
+}
+
+// a < b as integers
+SHARED_FN bool fp_less(Fp a, Fp b) {
+    uint borrow = 0u;
+    for (uint i = 0; i < FP_LIMBS; ++i) {
+        uint b0, b1;
+        uint d = usubBorrow(a.l[i], b.l[i], b0);
+        usubBorrow(d, borrow, b1);
+        borrow = b0 | b1;
+    }
+    return borrow != 0u;
+}
+
+// a < p, i.e. a is a field element
+SHARED_FN bool fp_is_reduced(Fp a) {
+    Fp p;
+    for (uint i = 0; i < FP_LIMBS; ++i) p.l[i] = FP_MODULUS[i];
+    return fp_less(a, p);
+}
+
+// A square root of a when a is a square; callers check by squaring
+SHARED_FN Fp fp_sqrt(Fp a) {
+    Fp r = fp_one();
+    for (uint k = 0; k < FP_LIMBS * 32u; ++k) {
+        uint bit = FP_LIMBS * 32u - 1u - k;
+        r = fp_sqr(r);
+        if (((FP_SQRT_EXPONENT[bit / 32u] >> (bit % 32u)) & 1u) != 0u) r = fp_mul(r, a);
+    }
+    return r;
+}
+
+// r = a - r if a >= r (a < 2r, with `hi` the carry out of the top limb)
+SHARED_FN Fr fr_reduce_once(Fr a, uint hi) {
+    Fr r;
+    uint borrow = 0u;
+    for (uint i = 0; i < FR_LIMBS; ++i) {
+        uint b0, b1;
+        uint d = usubBorrow(a.l[i], FR_MODULUS[i], b0);
+        r.l[i] = usubBorrow(d, borrow, b1);
+        borrow = b0 | b1;
+    }
+    return (borrow > hi) ? a : r;
+}
+
+SHARED_FN Fr fr_add(Fr a, Fr b) {
+    Fr r;
+    uint carry = 0u;
+    for (uint i = 0; i < FR_LIMBS; ++i) {
+        uint c0, c1;
+        uint s = uaddCarry(a.l[i], b.l[i], c0);
+        r.l[i] = uaddCarry(s, carry, c1);
+        carry = c0 | c1;
+    }
+    return fr_reduce_once(r, carry);
+}
+
+SHARED_FN Fr fr_sub(Fr a, Fr b) {
+    Fr r;
+    uint borrow = 0u;
+    for (uint i = 0; i < FR_LIMBS; ++i) {
+        uint b0, b1;
+        uint d = usubBorrow(a.l[i], b.l[i], b0);
+        r.l[i] = usubBorrow(d, borrow, b1);
+        borrow = b0 | b1;
+    }
+    if (borrow != 0u) {
+        uint carry = 0u;
+        for (uint i = 0; i < FR_LIMBS; ++i) {
+            uint c0, c1;
+            uint s = uaddCarry(r.l[i], FR_MODULUS[i], c0);
+            r.l[i] = uaddCarry(s, carry, c1);
+            carry = c0 | c1;
+        }
+    }
+    return r;
+}
+
+// Montgomery multiplication a * b * R^-1 mod r (CIOS)
+SHARED_FN Fr fr_mul(Fr a, Fr b) {
+    uint t[FR_LIMBS + 2];
+    for (uint i = 0; i < FR_LIMBS + 2; ++i) t[i] = 0u;
+
+    for (uint i = 0; i < FR_LIMBS; ++i) {
+        uint c = 0u;
+        for (uint j = 0; j < FR_LIMBS; ++j) mac(a.l[j], b.l[i], t[j], c, c, t[j]);
+        uint carry;
+        t[FR_LIMBS] = uaddCarry(t[FR_LIMBS], c, carry);
+        t[FR_LIMBS + 1] = carry;
+
+        uint m = t[0] * FR_INV;
+        uint lo;
+        mac(m, FR_MODULUS[0], t[0], 0u, c, lo);
+        for (uint j = 1; j < FR_LIMBS; ++j) mac(m, FR_MODULUS[j], t[j], c, c, t[j - 1]);
+        t[FR_LIMBS - 1] = uaddCarry(t[FR_LIMBS], c, carry);
+        t[FR_LIMBS] = t[FR_LIMBS + 1] + carry;
+    }
+
+    Fr r;
+    for (uint i = 0; i < FR_LIMBS; ++i) r.l[i] = t[i];
+    return fr_reduce_once(r, t[FR_LIMBS]);
+}
+
+SHARED_FN Fr fr_sqr(Fr a) {
+    return fr_mul(a, a);
+}
+
+#endif  // BLS12_381_FIELD_H
@@ -0,0 +1,285 @@
+// BLS12-381 G1 arithmetic shared between the compute shaders and the host (see
+// bls12_381_field.h).
+//
+// Jacobian points (X/Z^2, Y/Z^3) match blst_p1, with Z = 0 as the point at infinity. XYZZ points
+// (X/ZZ, Y/ZZZ, ZZ^3 = ZZZ^2) trade a larger point for cheaper mixed additions, with ZZ = 0 as
+// infinity. Formulas are the a = 0 ones from the Explicit-Formulas Database.
+#ifndef BLS12_381_G1_H
+#define BLS12_381_G1_H
+
+#include "bls12_381_field.h"
+
+// 4 in Montgomery form: the curve is y^2 = x^3 + 4
+const uint G1_B[FP_LIMBS] = SHARED_ARRAY_BEGIN(uint, FP_LIMBS)
+    0x000cfff3u, 0xaa270000u, 0xfc34000au, 0x53cc0032u, 0x6b0a807fu, 0x478fe97au,
+    0xe6ba24d7u, 0xb1d37ebeu, 0xbf78ab2fu, 0x8ec9733bu, 0x3d83de7eu, 0x09d64551u SHARED_ARRAY_END;
+
+// Flags in the top bits of a compressed point's x, as blst_p1_compress sets them
+const uint G1_FLAG_COMPRESSED = 0x80000000u;
+const uint G1_FLAG_INFINITY = 0x40000000u;
+const uint G1_FLAG_SIGN = 0x20000000u;  // y is the larger of y and p - y
+const uint G1_FLAGS = 0xe0000000u;
+
+struct G1Affine {
+    Fp x;
+    Fp y;
+};
+
+struct G1Jacobian {
+    Fp x;
+    Fp y;
+    Fp z;
+};
+
+struct G1Xyzz {
+    Fp x;
+    Fp y;
+    Fp zz;
+    Fp zzz;
+};
+
+SHARED_FN G1Jacobian g1_infinity() {
+    G1Jacobian r;
+    r.x = fp_one();
+    r.y = fp_one();
+    r.z = fp_zero();
+    return r;
+}
+
+SHARED_FN bool g1_is_infinity(G1Jacobian p) {
+    return fp_is_zero(p.z);
+}
+
+// blst encodes the affine point at infinity as (0, 0)
+SHARED_FN bool g1_affine_is_infinity(G1Affine p) {
+    return fp_is_zero(p.x) && fp_is_zero(p.y);
+}
+
+// (x, -y); infinity stays (0, 0) since 0 - 0 needs no correction
+SHARED_FN G1Affine g1_neg_affine(G1Affine p) {
+    p.y = fp_sub(fp_zero(), p.y);
+    return p;
+}
+
+// dbl-2009-l
+SHARED_FN G1Jacobian g1_dbl(G1Jacobian p) {
+    if (g1_is_infinity(p)) return p;
+    Fp a = fp_sqr(p.x);
+    Fp b = fp_sqr(p.y);
+    Fp c = fp_sqr(b);
+    Fp d = fp_dbl(fp_sub(fp_sub(fp_sqr(fp_add(p.x, b)), a), c));
+    Fp e = fp_add(fp_dbl(a), a);
+    Fp f = fp_sqr(e);
+
+    G1Jacobian r;
+    r.x = fp_sub(f, fp_dbl(d));
+    Fp c8 = fp_dbl(fp_dbl(fp_dbl(c)));
+    r.y = fp_sub(fp_mul(e, fp_sub(d, r.x)), c8);
+    r.z = fp_dbl(fp_mul(p.y, p.z));
+    return r;
+}
+
+// madd-2007-bl: Jacobian + affine
+SHARED_FN G1Jacobian g1_add_affine(G1Jacobian p, G1Affine q) {
+    if (g1_affine_is_infinity(q)) return p;
+    if (g1_is_infinity(p)) {
+        G1Jacobian r;
+        r.x = q.x;
+        r.y = q.y;
+        r.z = fp_one();
+        return r;
+    }
+    Fp z1z1 = fp_sqr(p.z);
+    Fp u2 = fp_mul(q.x, z1z1);
+    Fp s2 = fp_mul(q.y, fp_mul(p.z, z1z1));
+    Fp h = fp_sub(u2, p.x);
+    Fp rr = fp_dbl(fp_sub(s2, p.y));
+    if (fp_is_zero(h)) {
+        if (fp_is_zero(rr)) return g1_dbl(p);
+        return g1_infinity();
+    }
+    Fp hh = fp_sqr(h);
+    Fp i = fp_dbl(fp_dbl(hh));
+    Fp j = fp_mul(h, i);
+    Fp v = fp_mul(p.x, i);
+
+    G1Jacobian r;
+    r.x = fp_sub(fp_sub(fp_sqr(rr), j), fp_dbl(v));
+    r.y = fp_sub(fp_mul(rr, fp_sub(v, r.x)), fp_dbl(fp_mul(p.y, j)));
+    r.z = fp_sub(fp_sub(fp_sqr(fp_add(p.z, h)), z1z1), hh);
+    return r;
+}
+
+// add-2007-bl: Jacobian + Jacobian
+SHARED_FN G1Jacobian g1_add(G1Jacobian p, G1Jacobian q) {
+    if (g1_is_infinity(p)) return q;
+    if (g1_is_infinity(q)) return p;
+    Fp z1z1 = fp_sqr(p.z);
+    Fp z2z2 = fp_sqr(q.z);
+    Fp u1 = fp_mul(p.x, z2z2);
+    Fp u2 = fp_mul(q.x, z1z1);
+    Fp s1 = fp_mul(p.y, fp_mul(q.z, z2z2));
+    Fp s2 = fp_mul(q.y, fp_mul(p.z, z1z1));
+    Fp h = fp_sub(u2, u1);
+    Fp rr = fp_dbl(fp_sub(s2, s1));
+    if (fp_is_zero(h)) {
+        if (fp_is_zero(rr)) return g1_dbl(p);
+        return g1_infinity();
+    }
+    Fp i = fp_sqr(fp_dbl(h));
+    Fp j = fp_mul(h, i);
+    Fp v = fp_mul(u1, i);
+
+    G1Jacobian r;
+    r.x = fp_sub(fp_sub(fp_sqr(rr), j), fp_dbl(v));
+    r.y = fp_sub(fp_mul(rr, fp_sub(v, r.x)), fp_dbl(fp_mul(s1, j)));
+    r.z = fp_mul(fp_sub(fp_sub(fp_sqr(fp_add(p.z, q.z)), z1z1), z2z2), h);
+    return r;
+}
+
+SHARED_FN G1Xyzz g1_xyzz_infinity() {
+    G1Xyzz r;
+    r.x = fp_one();
+    r.y = fp_one();
+    r.zz = fp_zero();
+    r.zzz = fp_zero();
+    return r;
+}
+
+SHARED_FN bool g1_xyzz_is_infinity(G1Xyzz p) {
+    return fp_is_zero(p.zz);
+}
+
+// (X, Y, Z^2, Z^3) represents the same point as Jacobian (X, Y, Z)
+SHARED_FN G1Xyzz g1_xyzz_from_jacobian(G1Jacobian p) {
+    G1Xyzz r;
+    r.x = p.x;
+    r.y = p.y;
+    r.zz = fp_sqr(p.z);
+    r.zzz = fp_mul(r.zz, p.z);
+    return r;
+}
+
+// Jacobian with Z = ZZZ: Z^2 = ZZZ^2 = ZZ^3, so X = x * ZZ^3 = X_xyzz * ZZ^2 and likewise for Y
+SHARED_FN G1Jacobian g1_xyzz_to_jacobian(G1Xyzz p) {
+    if (g1_xyzz_is_infinity(p)) return g1_infinity();
+    G1Jacobian r;
+    r.x = fp_mul(p.x, fp_sqr(p.zz));
+    r.y = fp_mul(p.y, fp_sqr(p.zzz));
+    r.z = p.zzz;
+    return r;
+}
+
+// dbl-2008-s-1
+SHARED_FN G1Xyzz g1_xyzz_dbl(G1Xyzz p) {
+    if (g1_xyzz_is_infinity(p)) return p;
+    Fp u = fp_dbl(p.y);
+    Fp v = fp_sqr(u);
+    Fp w = fp_mul(u, v);
+    Fp s = fp_mul(p.x, v);
+    Fp xx = fp_sqr(p.x);
+    Fp m = fp_add(fp_dbl(xx), xx);
+
+    G1Xyzz r;
+    r.x = fp_sub(fp_sqr(m), fp_dbl(s));
+    r.y = fp_sub(fp_mul(m, fp_sub(s, r.x)), fp_mul(w, p.y));
+    r.zz = fp_mul(v, p.zz);
+    r.zzz = fp_mul(w, p.zzz);
+    return r;
+}
+
+// madd-2008-s: XYZZ + affine
+SHARED_FN G1Xyzz g1_xyzz_add_affine(G1Xyzz p, G1Affine q) {
+    if (g1_affine_is_infinity(q)) return p;
+    if (g1_xyzz_is_infinity(p)) {
+        G1Xyzz r;
+        r.x = q.x;
+        r.y = q.y;
+        r.zz = fp_one();
+        r.zzz = fp_one();
+        return r;
+    }
+    Fp u2 = fp_mul(q.x, p.zz);
+    Fp s2 = fp_mul(q.y, p.zzz);
+    Fp pp = fp_sub(u2, p.x);
+    Fp rr = fp_sub(s2, p.y);
+    if (fp_is_zero(pp)) {
+        if (fp_is_zero(rr)) return g1_xyzz_dbl(p);
+        return g1_xyzz_infinity();
+    }
+    Fp pp2 = fp_sqr(pp);
+    Fp pp3 = fp_mul(pp, pp2);
+    Fp q1 = fp_mul(p.x, pp2);
+
+    G1Xyzz r;
+    r.x = fp_sub(fp_sub(fp_sqr(rr), pp3), fp_dbl(q1));
+    r.y = fp_sub(fp_mul(rr, fp_sub(q1, r.x)), fp_mul(p.y, pp3));
+    r.zz = fp_mul(p.zz, pp2);
+    r.zzz = fp_mul(p.zzz, pp3);
+    return r;
+}
+
+// add-2008-s: XYZZ + XYZZ
+SHARED_FN G1Xyzz g1_xyzz_add(G1Xyzz p, G1Xyzz q) {
+    if (g1_xyzz_is_infinity(p)) return q;
+    if (g1_xyzz_is_infinity(q)) return p;
+    Fp u1 = fp_mul(p.x, q.zz);
+    Fp u2 = fp_mul(q.x, p.zz);
+    Fp s1 = fp_mul(p.y, q.zzz);
+    Fp s2 = fp_mul(q.y, p.zzz);
+    Fp pp = fp_sub(u2, u1);
+    Fp rr = fp_sub(s2, s1);
+    if (fp_is_zero(pp)) {
+        if (fp_is_zero(rr)) return g1_xyzz_dbl(p);
+        return g1_xyzz_infinity();
+    }
+    Fp pp2 = fp_sqr(pp);
+    Fp pp3 = fp_mul(pp, pp2);
+    Fp q1 = fp_mul(u1, pp2);
+
+    G1Xyzz r;
+    r.x = fp_sub(fp_sub(fp_sqr(rr), pp3), fp_dbl(q1));
+    r.y = fp_sub(fp_mul(rr, fp_sub(q1, r.x)), fp_mul(s1, pp3));
+    r.zz = fp_mul(fp_mul(p.zz, q.zz), pp2);
+    r.zzz = fp_mul(fp_mul(p.zzz, q.zzz), pp3);
+    return r;
+}
+
+SHARED_FN uint byte_swap(uint x) {
+    return (x >> 24) | ((x >> 8) & 0xff00u) | ((x << 8) & 0xff0000u) | (x << 24);
+}
+
+// x of a compressed point, flags included, from its 48 bytes read as little-endian words
+SHARED_FN Fp g1_compressed_x(Fp words) {
+    Fp x;
+    for (uint j = 0; j < FP_LIMBS; ++j) x.l[j] = byte_swap(words.l[FP_LIMBS - 1u - j]);
+    return x;
+}
+
+// The affine point of a compressed x as blst_p1_uncompress decodes it, without the subgroup
+// check. False, with p = (0, 0), for a bad encoding or an x with no point on the curve.
+SHARED_FN bool g1_decompress(Fp x, SHARED_OUT(G1Affine) p) {
+    uint flags = x.l[FP_LIMBS - 1u] & G1_FLAGS;
+    x.l[FP_LIMBS - 1u] &= ~G1_FLAGS;
+    p.x = fp_zero();
+    p.y = fp_zero();
+    if ((flags & G1_FLAG_COMPRESSED) == 0u) return false;
+    if ((flags & G1_FLAG_INFINITY) != 0u) return (flags & G1_FLAG_SIGN) == 0u && fp_is_zero(x);
+    if (!fp_is_reduced(x)) return false;
+
+    Fp b;
+    for (uint i = 0; i < FP_LIMBS; ++i) b.l[i] = G1_B[i];
+    Fp mx = fp_to_montgomery(x);
+    Fp rhs = fp_add(fp_mul(fp_sqr(mx), mx), b);
+    Fp y = fp_sqrt(rhs);
+    if (!fp_eq(fp_sqr(y), rhs)) return false;
+
+    // y != 0, as no point of order 2 lies on the curve
+    Fp neg_y = fp_sub(fp_zero(), y);
+    bool larger = fp_less(fp_from_montgomery(neg_y), fp_from_montgomery(y));
+    p.x = mx;
+    p.y = larger == ((flags & G1_FLAG_SIGN) != 0u) ? y : neg_y;
+    return true;
+}
+
+#endif  // BLS12_381_G1_H
@@ -6,23 +6,37 @@
 typedef uint32_t uint;
 #define GET_DATA(buf) (buf).data()
 #define SHARED_FN inline
+#define SHARED_OUT(type) type&
+#define SHARED_ARRAY_BEGIN(type, size) {
+#define SHARED_ARRAY_END }
 #else
 // GLSL compatibility
 #define GET_DATA(buf) (buf).data
 #define SHARED_FN
+#define SHARED_OUT(type) out type
+#define SHARED_ARRAY_BEGIN(type, size) type[size](
+#define SHARED_ARRAY_END )
 #endif
 
+// Shared functions return through SHARED_OUT parameters, and shared constant arrays are written
+//     const uint NAME[N] = SHARED_ARRAY_BEGIN(uint, N) a, b, ... SHARED_ARRAY_END;
+// which is an initializer list in C++ and an array constructor in GLSL
+
 // Shared Indexing Function: (batch, row, col) -> linear index
 SHARED_FN uint IX3D(uint b, uint r, uint c, uint rows, uint cols) {
     return (b * rows * cols) + (r * cols) + c;
 }
 
-const uint BATCH = 32;
-const uint M = 128;
-const uint K = 128;
-const uint N = 128;
+// Default problem sizes, overridden at runtime by --batch, --m, --k, --n, --msm-points and
+// --ntt-log
+const uint DEFAULT_BATCH = 32;
+const uint DEFAULT_M = 128;
+const uint DEFAULT_K = 128;
+const uint DEFAULT_N = 128;
+
+const uint DEFAULT_MSM_POINTS = 1 << 16;  // 65536 points
 
-const uint MSM_POINTS = 1 << 16;  // 65536 points
+const uint DEFAULT_NTT_LOG_N = 16;  // transforms of 65536 values
 
 struct MatrixParams {
     uint batch;
@@ -31,8 +45,118 @@ struct MatrixParams {
     uint n;
 };
 
+// Pippenger stages in msm.comp, one dispatch each. The first four sort (point, bucket) pairs by
+// bucket and also make up msm_sort.comp.
+const uint MSM_STAGE_CLEAR = 0;
+const uint MSM_STAGE_COUNT = 1;
+const uint MSM_STAGE_PREFIX = 2;
+const uint MSM_STAGE_SCATTER = 3;
+const uint MSM_STAGE_ACCUMULATE = 4;
+const uint MSM_STAGE_MERGE = 5;
+const uint MSM_STAGE_REDUCE = 6;
+const uint MSM_STAGE_COMBINE = 7;
+const uint MSM_SORT_STAGES = 4;
+const uint MSM_STAGES = 8;
+
+const uint MSM_SCALAR_BITS = 255;
+const uint MSM_SCALAR_WORDS = 8;  // blst_scalar as 32-bit words
+
+// Bucket list entries are point indices, with this bit set when the point is negated
+const uint MSM_NEGATE_BIT = 0x80000000u;
+
+// Scalars are Booth-recoded into signed c-bit digits in [-2^(c-1), 2^(c-1)]; one window past the
+// top scalar bit absorbs the final carry
+SHARED_FN uint msm_num_windows(uint window_bits) {
+    return MSM_SCALAR_BITS / window_bits + 1u;
+}
+
+// Digit d selects bucket |d| - 1
+SHARED_FN uint msm_num_buckets(uint window_bits) {
+    return 1u << (window_bits - 1u);
+}
+
+// Digit of window w from `bits`, the scalar bits [w * c - 1, w * c + c) with bit -1 taken as 0
+SHARED_FN int msm_booth_digit(uint bits, uint window_bits) {
+    return int(bits >> 1) + int(bits & 1u) - int((bits >> window_bits) << window_bits);
+}
+
 struct MsmParams {
     uint points;
+    uint window_bits;  // c: each window selects one of 2^(c-1) buckets by a signed digit
+    uint num_windows;  // msm_num_windows(c)
+    uint segments;     // parts of each bucket's list accumulated independently, then merged
+    uint stage;
+    // Windows sharing one entry of the point table. Binding 0 holds ceil(num_windows /
+    // windows_per_group) groups of `points` affine points, each group limb-major (see
+    // g1_soa_index), group g being the bases times 2^(g * windows_per_group * window_bits).
+    // Plain MSM has one group, the bases themselves.
+    uint windows_per_group;
+    // Independent MSMs evaluated together, each with its own scalars ([msm][point]), buckets and
+    // result. With shared_bases 0, binding 0 holds one point table per MSM.
+    uint batch;
+    uint shared_bases;
+    // Streaming: nonzero when ACCUMULATE adds segment 0 onto the bucket sums left there by earlier
+    // chunks of the same MSM instead of overwriting them
+    uint accumulate;
 };
 
+// Device layout of affine points: word w of point i of a table of `count` points, where words
+// 0-11 are the limbs of x and 12-23 those of y. Neighbouring invocations reading the same limb of
+// neighbouring points then load consecutive words.
+const uint G1_SOA_WORDS = 24;
+
+SHARED_FN uint g1_soa_index(uint count, uint i, uint word) {
+    return word * count + i;
+}
+
+// Compressed G1 points as 32-bit words: the 48-byte big-endian x with the flag bits on top
+const uint G1_COMPRESSED_WORDS = 12;
+
+// g1_points.comp fills a table in the layout above from blst_p1_affine[] (TRANSPOSE) or from
+// compressed points (DECOMPRESS), after CLEAR zeroes its count of invalid encodings
+struct PointsParams {
+    uint count;
+    uint stage;
+};
+
+// Points per g1_points.comp workgroup
+const uint POINTS_WORKGROUP_SIZE = 64;
+
+const uint POINTS_STAGE_CLEAR = 0;
+const uint POINTS_STAGE_TRANSPOSE = 1;
+const uint POINTS_STAGE_DECOMPRESS = 2;
+
+// Number-theoretic transform over Fr of n = 2^log_n values in natural order, run by ntt.comp as
+// log_n radix-2 Stockham stages, one dispatch each
+struct NttParams {
+    uint log_n;
+    uint stage;
+    uint inverse;  // nonzero: the inverse transform, including the 1/n scaling
+    // Nonzero: evaluate over the coset shift * H, i.e. scale input i by shift^i before a forward
+    // transform, or output i by shift^-i after an inverse one
+    uint coset;
+};
+
+const uint NTT_MAX_LOG_N = 32;  // two-adicity of r - 1
+// Largest transform: n = 2^log_n must fit in a uint on the host and in ntt.comp
+const uint NTT_MAX_SIZE_LOG_N = 31;
+
+// Device table of Fr values for one transform size, see ntt_table_size: omega^j for j < n / 2,
+// then omega^-j, then shift^(2^i) and shift^-(2^i) for i < NTT_MAX_LOG_N, then 1/n
+SHARED_FN uint ntt_twiddle_index(uint n, uint j, uint inverse) {
+    return (inverse != 0u ? n / 2u : 0u) + j;
+}
+
+SHARED_FN uint ntt_shift_power_index(uint n, uint i, uint inverse) {
+    return n + (inverse != 0u ? NTT_MAX_LOG_N : 0u) + i;
+}
+
+SHARED_FN uint ntt_inv_n_index(uint n) {
+    return n + 2u * NTT_MAX_LOG_N;
+}
+
+SHARED_FN uint ntt_table_size(uint n) {
+    return ntt_inv_n_index(n) + 1u;
+}
+
 #endif  // COMMON_H
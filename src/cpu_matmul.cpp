@@ -3,42 +3,361 @@
 #include <immintrin.h>
 #include <omp.h>
 
-void cpu_matmul(const std::vector<float>& A, const std::vector<float>& B, std::vector<float>& C,
-                const MatrixParams& params) {
-    const float* A_ptr = A.data();
-    const float* B_ptr = B.data();
-    float* C_ptr = C.data();
-
-// Parallelize over batch and rows (m)
-#pragma omp parallel for collapse(2)
-    for (uint b = 0; b < params.batch; ++b) {
-        for (uint i = 0; i < params.m; ++i) {
-            // Pointer to C[b][i][0]
-            float* C_row = C_ptr + b * params.m * params.n + i * params.n;
-
-            for (uint k = 0; k < params.k; ++k) {
-                // Value A[b][i][k] broadcasted to AVX register
-                float A_val = A_ptr[b * params.m * params.k + i * params.k + k];
-                __m256 vec_A = _mm256_set1_ps(A_val);
-
-                // Pointer to B[b][k][0]
-                const float* B_row = B_ptr + b * params.k * params.n + k * params.n;
-
-                // Vectorized loop over j
-                for (uint j = 0; j < params.n; j += 8) {
-                    // Load 8 floats from C (accumulators)
-                    __m256 vec_C = _mm256_loadu_ps(C_row + j);
-
-                    // Load 8 floats from B
-                    __m256 vec_B = _mm256_loadu_ps(B_row + j);
-
-                    // C += A * B
-                    vec_C = _mm256_fmadd_ps(vec_A, vec_B, vec_C);
-
-                    // Store back to C
-                    _mm256_storeu_ps(C_row + j, vec_C);
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX512_TARGET
+#else
+#include <cpuid.h>
+#define AVX512_TARGET __attribute__((target("avx512f")))
+#endif
+
+// Blocking in the style of BLIS/GotoBLAS: a KC x NR panel of packed B stays in L1 across one
+// micro-kernel call, an MC x KC block of packed A in L2, and a KC x NC block of packed B in L3.
+const uint MC = 96;   // multiple of MR
+const uint KC = 256;
+const uint NC = 512;  // multiple of both NR values
+
+// Register tiles: MR rows of C, each NR floats wide, held in 12 vector accumulators
+const uint MR = 6;
+const uint NR_AVX2 = 16;
+const uint NR_AVX512 = 32;
+
+// AVX-512F usable: CPUID.7.0:EBX bit 16, and the OS saves opmask and ZMM state (XCR0 bits 1, 2,
+// 5, 6, 7)
+static bool cpu_has_avx512f() {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    ecx = info[2];
+#else
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+#endif
+    if (!(ecx & (1u << 27))) return false;  // OSXSAVE
+
+#if defined(_MSC_VER)
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    ebx = info[1];
+#else
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    unsigned long long xcr0 = ((unsigned long long)xcr0_hi << 32) | xcr0_lo;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+#endif
+    return (xcr0 & 0xE6) == 0xE6 && (ebx & (1u << 16));
+}
+
+// C[0..mr) x [0..nr) (+)= packed A sliver (kc x MR, k-major) * packed B panel (kc x NR_AVX2)
+static void kernel_avx2(uint kc, const float* A, const float* B, float* C, uint ldc, uint mr,
+                        uint nr, bool accumulate) {
+    __m256 c[MR][2];
+    for (uint i = 0; i < MR; ++i) c[i][0] = c[i][1] = _mm256_setzero_ps();
+
+    for (uint p = 0; p < kc; ++p) {
+        __m256 b0 = _mm256_load_ps(B + p * NR_AVX2);
+        __m256 b1 = _mm256_load_ps(B + p * NR_AVX2 + 8);
+        for (uint i = 0; i < MR; ++i) {
+            __m256 a = _mm256_broadcast_ss(A + p * MR + i);
+            c[i][0] = _mm256_fmadd_ps(a, b0, c[i][0]);
+            c[i][1] = _mm256_fmadd_ps(a, b1, c[i][1]);
+        }
+    }
+
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (uint h = 0; h < 2; ++h) {
+        if (nr <= h * 8) break;
+        uint cols = std::min(8u, nr - h * 8);
+        __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(cols), lanes);
+        for (uint i = 0; i < mr; ++i) {
+            float* dst = C + i * ldc + h * 8;
+            __m256 v = c[i][h];
+            if (cols == 8) {
+                if (accumulate) v = _mm256_add_ps(v, _mm256_loadu_ps(dst));
+                _mm256_storeu_ps(dst, v);
+            } else {
+                if (accumulate) v = _mm256_add_ps(v, _mm256_maskload_ps(dst, mask));
+                _mm256_maskstore_ps(dst, mask, v);
+            }
+        }
+    }
+}
+
+// As kernel_avx2 with a kc x NR_AVX512 panel of B
+AVX512_TARGET static void kernel_avx512(uint kc, const float* A, const float* B, float* C,
+                                        uint ldc, uint mr, uint nr, bool accumulate) {
+    __m512 c[MR][2];
+    for (uint i = 0; i < MR; ++i) c[i][0] = c[i][1] = _mm512_setzero_ps();
+
+    for (uint p = 0; p < kc; ++p) {
+        __m512 b0 = _mm512_load_ps(B + p * NR_AVX512);
+        __m512 b1 = _mm512_load_ps(B + p * NR_AVX512 + 16);
+        for (uint i = 0; i < MR; ++i) {
+            __m512 a = _mm512_set1_ps(A[p * MR + i]);
+            c[i][0] = _mm512_fmadd_ps(a, b0, c[i][0]);
+            c[i][1] = _mm512_fmadd_ps(a, b1, c[i][1]);
+        }
+    }
+
+    for (uint h = 0; h < 2; ++h) {
+        if (nr <= h * 16) break;
+        uint cols = std::min(16u, nr - h * 16);
+        __mmask16 mask = (__mmask16)((1u << cols) - 1);
+        for (uint i = 0; i < mr; ++i) {
+            float* dst = C + i * ldc + h * 16;
+            __m512 v = c[i][h];
+            if (accumulate) v = _mm512_add_ps(v, _mm512_maskz_loadu_ps(mask, dst));
+            _mm512_mask_storeu_ps(dst, mask, v);
+        }
+    }
+}
+
+// int8 variant of kernel_avx2 over k-pair packing (pack_a_i8, pack_b_i8): each 32-bit element
+// holds two consecutive k values as int16, so _mm256_madd_epi16 multiplies and adds a pair for 8
+// columns at once. Products of int8 never saturate the int16 pairs; the int32 sums wrap.
+static void kernel_i8_avx2(uint kc, const int32_t* A, const int32_t* B, int32_t* C, uint ldc,
+                           uint mr, uint nr, bool accumulate) {
+    __m256i c[MR][2];
+    for (uint i = 0; i < MR; ++i) c[i][0] = c[i][1] = _mm256_setzero_si256();
+
+    for (uint p = 0; p < (kc + 1) / 2; ++p) {
+        __m256i b0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(B + p * NR_AVX2));
+        __m256i b1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(B + p * NR_AVX2 + 8));
+        for (uint i = 0; i < MR; ++i) {
+            __m256i a = _mm256_set1_epi32(A[p * MR + i]);
+            c[i][0] = _mm256_add_epi32(c[i][0], _mm256_madd_epi16(a, b0));
+            c[i][1] = _mm256_add_epi32(c[i][1], _mm256_madd_epi16(a, b1));
+        }
+    }
+
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (uint h = 0; h < 2; ++h) {
+        if (nr <= h * 8) break;
+        uint cols = std::min(8u, nr - h * 8);
+        __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(cols), lanes);
+        for (uint i = 0; i < mr; ++i) {
+            int32_t* dst = C + i * ldc + h * 8;
+            __m256i v = c[i][h];
+            if (cols == 8) {
+                __m256i* dst_vec = reinterpret_cast<__m256i*>(dst);
+                if (accumulate) v = _mm256_add_epi32(v, _mm256_loadu_si256(dst_vec));
+                _mm256_storeu_si256(dst_vec, v);
+            } else {
+                if (accumulate) v = _mm256_add_epi32(v, _mm256_maskload_epi32(dst, mask));
+                _mm256_maskstore_epi32(dst, mask, v);
+            }
+        }
+    }
+}
+
+struct alignas(64) CacheLine {
+    float values[16];
+};
+
+// One element type of the blocked matmul: T inputs, packed into 32-bit P elements holding
+// K_PER_WORD consecutive k values each, multiplied by a micro-kernel into Out
+template <typename T, typename P, typename Out>
+struct BlockedMatmul {
+    typedef void (*MicroKernel)(uint kc, const P* A, const P* B, Out* C, uint ldc, uint mr,
+                                uint nr, bool accumulate);
+    void (*pack_a)(const T* A, uint lda, uint mc, uint kc, P* packed);
+    void (*pack_b)(const T* B, uint ldb, uint kc, uint nc, uint nr, P* packed);
+    MicroKernel kernel;
+    uint nr;
+    uint k_per_word;
+};
+
+static inline float to_float(float v) {
+    return v;
+}
+
+static inline float to_float(uint16_t half) {
+    return _cvtsh_ss(half);
+}
+
+// dst[0, count) = src[0, count) as floats
+static inline void convert_row(const float* src, uint count, float* dst) {
+    std::copy(src, src + count, dst);
+}
+
+static inline void convert_row(const uint16_t* src, uint count, float* dst) {
+    uint j = 0;
+    for (; j + 8 <= count; j += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + j));
+        _mm256_storeu_ps(dst + j, _mm256_cvtph_ps(half));
+    }
+    for (; j < count; ++j) dst[j] = _cvtsh_ss(src[j]);
+}
+
+// Pack rows [0, mc) x cols [0, kc) of A (row stride lda) into MR-row slivers, each kc x MR with k
+// outermost. Rows past mc are zero so the micro-kernel always runs a full tile.
+template <typename T>
+static void pack_a(const T* A, uint lda, uint mc, uint kc, float* packed) {
+    for (uint i0 = 0; i0 < mc; i0 += MR) {
+        uint rows = std::min(MR, mc - i0);
+        for (uint p = 0; p < kc; ++p) {
+            for (uint i = 0; i < MR; ++i) {
+                *packed++ = i < rows ? to_float(A[(i0 + i) * lda + p]) : 0.0f;
+            }
+        }
+    }
+}
+
+// Pack rows [0, kc) x cols [0, nc) of B (row stride ldb) into nr-wide panels, each kc x nr.
+// Columns past nc are zero.
+template <typename T>
+static void pack_b(const T* B, uint ldb, uint kc, uint nc, uint nr, float* packed) {
+    for (uint j0 = 0; j0 < nc; j0 += nr) {
+        uint cols = std::min(nr, nc - j0);
+        for (uint p = 0; p < kc; ++p) {
+            convert_row(B + p * ldb + j0, cols, packed);
+            std::fill(packed + cols, packed + nr, 0.0f);
+            packed += nr;
+        }
+    }
+}
+
+// Two int8 as the int16 halves of one int32, `lo` in the low half
+static inline int32_t pack_pair(int8_t lo, int8_t hi) {
+    return (int32_t)((uint16_t)(int16_t)lo | ((uint32_t)(uint16_t)(int16_t)hi << 16));
+}
+
+// pack_a for int8, with k pairs in place of single k values; an odd kc pads with zero
+static void pack_a_i8(const int8_t* A, uint lda, uint mc, uint kc, int32_t* packed) {
+    for (uint i0 = 0; i0 < mc; i0 += MR) {
+        uint rows = std::min(MR, mc - i0);
+        for (uint p = 0; p < kc; p += 2) {
+            for (uint i = 0; i < MR; ++i) {
+                const int8_t* src = A + (i0 + i) * lda + p;
+                *packed++ = i < rows ? pack_pair(src[0], p + 1 < kc ? src[1] : 0) : 0;
+            }
+        }
+    }
+}
+
+// pack_b for int8, with k pairs in place of single k values
+static void pack_b_i8(const int8_t* B, uint ldb, uint kc, uint nc, uint nr, int32_t* packed) {
+    for (uint j0 = 0; j0 < nc; j0 += nr) {
+        uint cols = std::min(nr, nc - j0);
+        for (uint p = 0; p < kc; p += 2) {
+            const int8_t* row0 = B + p * ldb + j0;
+            const int8_t* row1 = row0 + ldb;
+            for (uint j = 0; j < nr; ++j) {
+                *packed++ = j < cols ? pack_pair(row0[j], p + 1 < kc ? row1[j] : 0) : 0;
+            }
+        }
+    }
+}
+
+// Each task is one (batch, MC rows, NC columns) block of C, so threads never share output. A task
+// packs its own A and B blocks; re-packing B per MC block costs 1/MC of the multiply.
+template <typename T, typename P, typename Out>
+static void matmul_blocked(const T* A_ptr, const T* B_ptr, Out* C_ptr, const MatrixParams& params,
+                           const BlockedMatmul<T, P, Out>& impl) {
+    const uint m = params.m, k = params.k, n = params.n;
+    const uint m_blocks = (m + MC - 1) / MC;
+    const uint n_blocks = (n + NC - 1) / NC;
+    const long tasks = (long)params.batch * m_blocks * n_blocks;
+
+    const uint nr = impl.nr;
+#pragma omp parallel
+    {
+        // Cache-line aligned packing buffers, one pair per thread
+        std::vector<CacheLine> a_storage(MC * KC / 16);
+        std::vector<CacheLine> b_storage(KC * NC / 16);
+        P* packed_a = reinterpret_cast<P*>(a_storage.data());
+        P* packed_b = reinterpret_cast<P*>(b_storage.data());
+
+#pragma omp for schedule(dynamic)
+        for (long t = 0; t < tasks; ++t) {
+            uint b = t / (m_blocks * n_blocks);
+            uint ic = (t / n_blocks) % m_blocks * MC;
+            uint jc = t % n_blocks * NC;
+            uint mc = std::min(MC, m - ic);
+            uint nc = std::min(NC, n - jc);
+            const T* A_b = A_ptr + (size_t)b * m * k;
+            const T* B_b = B_ptr + (size_t)b * k * n;
+            Out* C_b = C_ptr + (size_t)b * m * n;
+
+            for (uint pc = 0; pc < k; pc += KC) {
+                uint kc = std::min(KC, k - pc);
+                uint kw = (kc + impl.k_per_word - 1) / impl.k_per_word;  // packed depth
+                impl.pack_b(B_b + (size_t)pc * n + jc, n, kc, nc, nr, packed_b);
+                impl.pack_a(A_b + (size_t)ic * k + pc, k, mc, kc, packed_a);
+
+                for (uint jr = 0; jr < nc; jr += nr) {
+                    for (uint ir = 0; ir < mc; ir += MR) {
+                        Out* C_tile = C_b + (size_t)(ic + ir) * n + jc + jr;
+                        impl.kernel(kc, packed_a + ir * kw, packed_b + jr * kw, C_tile, n,
+                                    std::min(MR, mc - ir), std::min(nr, nc - jr), pc > 0);
+                    }
                 }
             }
         }
     }
 }
+
+static bool use_avx512() {
+    static const bool supported = cpu_has_avx512f();
+    return supported;
+}
+
+const char* cpu_matmul_isa() {
+    return use_avx512() ? "AVX-512" : "AVX2";
+}
+
+// The float matmul over inputs of type T (float, or fp16 converted while packing)
+template <typename T>
+static void matmul_float(const T* A, const T* B, float* C, const MatrixParams& params) {
+    if (use_avx512()) {
+        matmul_blocked(A, B, C, params,
+                       BlockedMatmul<T, float, float>{pack_a<T>, pack_b<T>, kernel_avx512,
+                                                      NR_AVX512, 1});
+    } else {
+        matmul_blocked(A, B, C, params,
+                       BlockedMatmul<T, float, float>{pack_a<T>, pack_b<T>, kernel_avx2, NR_AVX2,
+                                                      1});
+    }
+}
+
+void cpu_matmul(const std::vector<float>& A, const std::vector<float>& B, std::vector<float>& C,
+                const MatrixParams& params) {
+    if (params.k == 0) {
+        std::fill(C.begin(), C.end(), 0.0f);
+        return;
+    }
+    matmul_float(A.data(), B.data(), C.data(), params);
+}
+
+void cpu_matmul_f16(const std::vector<uint16_t>& A, const std::vector<uint16_t>& B,
+                    std::vector<float>& C, const MatrixParams& params) {
+    if (params.k == 0) {
+        std::fill(C.begin(), C.end(), 0.0f);
+        return;
+    }
+    matmul_float(A.data(), B.data(), C.data(), params);
+}
+
+void cpu_matmul_i8(const std::vector<int8_t>& A, const std::vector<int8_t>& B,
+                   std::vector<int32_t>& C, const MatrixParams& params) {
+    if (params.k == 0) {
+        std::fill(C.begin(), C.end(), 0);
+        return;
+    }
+    matmul_blocked(A.data(), B.data(), C.data(), params,
+                   BlockedMatmul<int8_t, int32_t, int32_t>{pack_a_i8, pack_b_i8, kernel_i8_avx2,
+                                                           NR_AVX2, 2});
+}
+
+void float_to_half(const float* src, uint16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), half);
+    }
+    for (; i < count; ++i) dst[i] = _cvtss_sh(src[i], _MM_FROUND_TO_NEAREST_INT);
+}
@@ -1,11 +1,31 @@
 #ifndef CPU_MATMUL_H
 #define CPU_MATMUL_H
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include "common.h"
 
+// C = A * B for each batch. Any m, k and n; uses AVX-512 when the CPU supports it, else AVX2.
 void cpu_matmul(const std::vector<float>& A, const std::vector<float>& B, std::vector<float>& C,
                 const MatrixParams& params);
 
+// As cpu_matmul with fp16 inputs (IEEE binary16 bit patterns), accumulating in fp32. The halves
+// are converted with F16C while packing, so the product is exactly cpu_matmul's on the rounded
+// inputs.
+void cpu_matmul_f16(const std::vector<uint16_t>& A, const std::vector<uint16_t>& B,
+                    std::vector<float>& C, const MatrixParams& params);
+
+// C = A * B over int8 inputs with int32 accumulation wrapping modulo 2^32 (exact while
+// k * 128 * 128 < 2^31). AVX2 on every CPU.
+void cpu_matmul_i8(const std::vector<int8_t>& A, const std::vector<int8_t>& B,
+                   std::vector<int32_t>& C, const MatrixParams& params);
+
+// Round `count` floats to the nearest fp16 (F16C)
+void float_to_half(const float* src, uint16_t* dst, size_t count);
+
+// Instruction set cpu_matmul dispatches to on this machine: "AVX-512" or "AVX2"
+const char* cpu_matmul_isa();
+
 #endif  // CPU_MATMUL_H
@@ -1,34 +1,307 @@
 #include "cpu_msm.h"
 
+#include <omp.h>
+
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
-#include "blst.h"
-
-void cpu_msm(const std::vector<float>& points_raw, const std::vector<float>& scalars_raw,
-             std::vector<float>& result_raw, const MsmParams& params) {
-    const blst_p1_affine* points = reinterpret_cast<const blst_p1_affine*>(points_raw.data());
-    const blst_scalar* scalars = reinterpret_cast<const blst_scalar*>(scalars_raw.data());
-
-    std::vector<const blst_p1_affine*> point_ptrs(params.points);
-    std::vector<const byte*> scalar_ptrs(params.points);
+void cpu_msm_blst(const blst_p1_affine* points, const blst_scalar* scalars, size_t n,
+                  blst_p1* result) {
+    if (n == 0) {
+        memset(result, 0, sizeof(blst_p1));
+        return;
+    }
+    std::vector<const blst_p1_affine*> point_ptrs(n);
+    std::vector<const byte*> scalar_ptrs(n);
 
-    for (size_t i = 0; i < params.points; ++i) {
+    for (size_t i = 0; i < n; ++i) {
         point_ptrs[i] = &points[i];
         scalar_ptrs[i] = reinterpret_cast<const byte*>(&scalars[i]);
     }
 
-    blst_p1 result;
-    size_t scratch_size = blst_p1s_mult_pippenger_scratch_sizeof(params.points);
+    size_t scratch_size = blst_p1s_mult_pippenger_scratch_sizeof(n);
     std::vector<limb_t> scratch(scratch_size / sizeof(limb_t) + 1);
 
-    blst_p1s_mult_pippenger(&result, point_ptrs.data(), params.points, scalar_ptrs.data(), 255,
+    blst_p1s_mult_pippenger(result, point_ptrs.data(), n, scalar_ptrs.data(), 255,
                             scratch.data());
+}
+
+// Parallel bucket method. Scalars are Booth-recoded into signed c-bit digits, so window w only
+// needs bits [wc - 1, wc + c) and digit d selects bucket |d| - 1 with the point negated for d < 0.
+// Buckets stay affine: a batch of additions into distinct buckets shares one field inversion by
+// Montgomery's trick, which makes each bucket addition about half the cost of a mixed addition.
+
+// Largest batch of bucket additions sharing one inversion. Larger batches amortise the inversion
+// further but collide more often on small bucket counts.
+const size_t MAX_AFFINE_BATCH = 512;
+
+// Below this many points the serial blst call wins
+const size_t MIN_PARALLEL_POINTS = 256;
+
+// Split one window's points into chunks so the (window, chunk) tasks keep every thread busy
+static uint cpu_msm_chunks(size_t n, uint num_windows, uint threads) {
+    uint chunks = (threads + num_windows - 1) / num_windows;
+    return (uint)std::max<size_t>(1, std::min<size_t>(chunks, n / MIN_PARALLEL_POINTS));
+}
+
+uint cpu_msm_window_bits(size_t n, uint threads) {
+    // Per window a task costs about one affine bucket addition per point plus two Jacobian
+    // additions per bucket in the reduction, each worth about four affine additions
+    uint best_c = 2;
+    double best_time = 0.0;
+    for (uint c = 2; c <= 20; ++c) {
+        uint windows = msm_num_windows(c);
+        uint chunks = cpu_msm_chunks(n, windows, threads);
+        double buckets = (double)(1u << (c - 1));
+        double work = windows * ((double)n + chunks * buckets * 8.0);
+        double time = work / std::min<double>(threads, (double)windows * chunks);
+        if (c == 2 || time < best_time) {
+            best_c = c;
+            best_time = time;
+        }
+    }
+    return best_c;
+}
+
+// Signed digit of window w: the scalar bits [wc - 1, wc + c), Booth-recoded as in msm.comp
+static int booth_digit(const blst_scalar& scalar, uint w, uint c) {
+    int start = (int)(w * c) - 1;
+    uint32_t bits = 0;
+    for (uint i = 0; i < 4; ++i) {
+        int byte_index = start < 0 ? (int)i - 1 : (start >> 3) + (int)i;
+        if (byte_index >= 0 && byte_index < 32) bits |= (uint32_t)scalar.b[byte_index] << (8 * i);
+    }
+    // Bit 0 of `bits` is scalar bit `start`, or 0 below the scalar
+    bits = start < 0 ? (bits >> 8) << 1 : bits >> (start & 7);
+    return msm_booth_digit(bits & ((2u << c) - 1), c);
+}
+
+static bool fp_equal(const blst_fp& a, const blst_fp& b) {
+    return memcmp(&a, &b, sizeof(blst_fp)) == 0;
+}
+
+// Affine buckets of one window with a pending batch of additions into distinct buckets. A point
+// for a bucket already in the batch waits in `deferred` until the batch is flushed.
+struct AffineBuckets {
+    std::vector<blst_p1_affine> buckets;
+    std::vector<uint8_t> occupied;
+    std::vector<uint32_t> batch_epoch;  // epoch in which a bucket last joined a batch
+    uint32_t epoch = 1;
+    size_t batch_capacity = 0;
+
+    std::vector<uint32_t> batch_bucket;
+    std::vector<blst_p1_affine> batch_point;
+    std::vector<blst_fp> denominator;
+    std::vector<blst_fp> prefix;  // running products of the denominators
+    std::vector<std::pair<uint32_t, blst_p1_affine>> deferred;
+
+    void reset(uint num_buckets) {
+        buckets.resize(num_buckets);
+        occupied.assign(num_buckets, 0);
+        batch_epoch.assign(num_buckets, 0);
+        epoch = 1;
+        batch_capacity = std::max<size_t>(1, std::min<size_t>(MAX_AFFINE_BATCH, num_buckets / 4));
+        batch_bucket.clear();
+        batch_point.clear();
+        denominator.resize(batch_capacity);
+        prefix.resize(batch_capacity);
+        deferred.clear();
+    }
+
+    // Queue bucket += point, or apply it at once when the bucket is empty or the point cancels it.
+    // False when the bucket already has an addition in the current batch.
+    bool try_add(uint32_t b, const blst_p1_affine& point) {
+        if (batch_epoch[b] == epoch) return false;
+        blst_p1_affine& bucket = buckets[b];
+        if (!occupied[b]) {
+            bucket = point;
+            occupied[b] = 1;
+            return true;
+        }
+        if (fp_equal(bucket.x, point.x) && !fp_equal(bucket.y, point.y)) {
+            occupied[b] = 0;  // P + (-P)
+            return true;
+        }
+        batch_epoch[b] = epoch;
+        batch_bucket.push_back(b);
+        batch_point.push_back(point);
+        return true;
+    }
+
+    void push(uint32_t b, const blst_p1_affine& point) {
+        // Flushing early on many collisions bounds the rescans of the deferred list
+        if (batch_bucket.size() >= batch_capacity || deferred.size() >= 2 * batch_capacity) {
+            flush();
+        }
+        if (!try_add(b, point)) deferred.emplace_back(b, point);
+    }
+
+    // Apply the batch with one inversion, then start a new batch from the deferred points
+    void flush() {
+        if (!batch_bucket.empty()) apply_batch(batch_bucket.size());
+        batch_bucket.clear();
+        batch_point.clear();
+        ++epoch;
 
-    blst_p1_affine result_affine;
-    blst_p1_to_affine(&result_affine, &result);
+        size_t kept = 0;
+        for (const auto& entry : deferred) {
+            if (batch_bucket.size() >= batch_capacity || !try_add(entry.first, entry.second)) {
+                deferred[kept++] = entry;
+            }
+        }
+        deferred.resize(kept);
+    }
 
-    if (result_raw.size() * sizeof(float) >= sizeof(blst_p1_affine)) {
-        memcpy(result_raw.data(), &result_affine, sizeof(blst_p1_affine));
+    void finish() {
+        while (!batch_bucket.empty() || !deferred.empty()) flush();
     }
+
+    void apply_batch(size_t count) {
+        // denominator: x2 - x1 for an addition, 2y for a doubling
+        for (size_t k = 0; k < count; ++k) {
+            const blst_p1_affine& bucket = buckets[batch_bucket[k]];
+            const blst_p1_affine& point = batch_point[k];
+            if (fp_equal(bucket.x, point.x)) {
+                blst_fp_add(&denominator[k], &bucket.y, &bucket.y);
+            } else {
+                blst_fp_sub(&denominator[k], &point.x, &bucket.x);
+            }
+            if (k == 0) {
+                prefix[0] = denominator[0];
+            } else {
+                blst_fp_mul(&prefix[k], &prefix[k - 1], &denominator[k]);
+            }
+        }
+
+        blst_fp inverse;
+        blst_fp_inverse(&inverse, &prefix[count - 1]);
+        for (size_t k = count; k-- > 0;) {
+            blst_fp inv_k = inverse;
+            if (k > 0) {
+                blst_fp_mul(&inv_k, &inverse, &prefix[k - 1]);
+                blst_fp_mul(&inverse, &inverse, &denominator[k]);
+            }
+
+            blst_p1_affine& bucket = buckets[batch_bucket[k]];
+            const blst_p1_affine& point = batch_point[k];
+            blst_fp lambda, t;
+            if (fp_equal(bucket.x, point.x)) {
+                blst_fp_sqr(&t, &bucket.x);  // 3x^2
+                blst_fp_add(&lambda, &t, &t);
+                blst_fp_add(&t, &lambda, &t);
+            } else {
+                blst_fp_sub(&t, &point.y, &bucket.y);
+            }
+            blst_fp_mul(&lambda, &t, &inv_k);
+
+            blst_p1_affine sum;
+            blst_fp_sqr(&sum.x, &lambda);
+            blst_fp_sub(&sum.x, &sum.x, &bucket.x);
+            blst_fp_sub(&sum.x, &sum.x, &point.x);
+            blst_fp_sub(&t, &bucket.x, &sum.x);
+            blst_fp_mul(&sum.y, &lambda, &t);
+            blst_fp_sub(&sum.y, &sum.y, &bucket.y);
+            bucket = sum;
+        }
+    }
+
+    // sum((b + 1) * bucket[b]) by running sums from the top bucket down
+    void reduce(blst_p1* result) const {
+        blst_p1 running, total;
+        memset(&running, 0, sizeof(running));
+        memset(&total, 0, sizeof(total));
+        for (size_t b = buckets.size(); b-- > 0;) {
+            if (occupied[b]) blst_p1_add_or_double_affine(&running, &running, &buckets[b]);
+            if (!blst_p1_is_inf(&running)) blst_p1_add_or_double(&total, &total, &running);
+        }
+        *result = total;
+    }
+};
+
+void cpu_msm_parallel(const blst_p1_affine* points, const blst_scalar* scalars, size_t n,
+                      blst_p1* result) {
+    uint threads = omp_get_max_threads();
+    if (n < MIN_PARALLEL_POINTS || threads <= 1) {
+        cpu_msm_blst(points, scalars, n, result);
+        return;
+    }
+
+    const uint c = cpu_msm_window_bits(n, threads);
+    const uint num_windows = msm_num_windows(c);
+    const uint chunks = cpu_msm_chunks(n, num_windows, threads);
+    const uint num_buckets = msm_num_buckets(c);
+    const long tasks = (long)num_windows * chunks;
+    std::vector<blst_p1> partial(tasks);
+
+#pragma omp parallel
+    {
+        AffineBuckets buckets;
+
+#pragma omp for schedule(dynamic)
+        for (long t = 0; t < tasks; ++t) {
+            uint w = t / chunks;
+            uint chunk = t % chunks;
+            size_t begin = n * chunk / chunks;
+            size_t end = n * (chunk + 1) / chunks;
+
+            buckets.reset(num_buckets);
+            for (size_t i = begin; i < end; ++i) {
+                int digit = booth_digit(scalars[i], w, c);
+                if (digit == 0 || blst_p1_affine_is_inf(&points[i])) continue;
+                blst_p1_affine point = points[i];
+                blst_fp_cneg(&point.y, &point.y, digit < 0);
+                buckets.push((uint32_t)std::abs(digit) - 1, point);
+            }
+            buckets.finish();
+            buckets.reduce(&partial[t]);
+        }
+    }
+
+    // Horner over the windows: result = sum(2^(wc) * window_sum[w])
+    blst_p1 sum;
+    memset(&sum, 0, sizeof(sum));
+    for (uint w = num_windows; w-- > 0;) {
+        for (uint i = 0; i < c && !blst_p1_is_inf(&sum); ++i) blst_p1_double(&sum, &sum);
+        for (uint chunk = 0; chunk < chunks; ++chunk) {
+            blst_p1_add_or_double(&sum, &sum, &partial[(size_t)w * chunks + chunk]);
+        }
+    }
+    *result = sum;
+}
+
+void cpu_msm_sort_buckets(const blst_scalar* scalars, uint n, uint window_bits,
+                          uint32_t* bucket_lists) {
+    const uint num_windows = msm_num_windows(window_bits);
+    const uint num_buckets = msm_num_buckets(window_bits);
+    uint32_t* entries_base = bucket_lists + (size_t)num_windows * num_buckets;
+
+#pragma omp parallel for schedule(dynamic)
+    for (int w = 0; w < (int)num_windows; ++w) {
+        uint32_t* offsets = bucket_lists + (size_t)w * num_buckets;
+        uint32_t* entries = entries_base + (size_t)w * n;
+        std::fill(offsets, offsets + num_buckets, 0);
+        for (uint i = 0; i < n; ++i) {
+            int digit = booth_digit(scalars[i], w, window_bits);
+            if (digit != 0) ++offsets[std::abs(digit) - 1];
+        }
+        uint32_t sum = 0;
+        for (uint b = 0; b < num_buckets; ++b) {
+            uint32_t count = offsets[b];
+            offsets[b] = sum;
+            sum += count;
+        }
+        for (uint i = 0; i < n; ++i) {
+            int digit = booth_digit(scalars[i], w, window_bits);
+            if (digit == 0) continue;
+            entries[offsets[std::abs(digit) - 1]++] = i | (digit < 0 ? MSM_NEGATE_BIT : 0);
+        }
+    }
+}
+
+void cpu_msm(const blst_p1_affine* points, const blst_scalar* scalars, size_t n,
+             blst_p1_affine* result) {
+    blst_p1 jacobian;
+    cpu_msm_parallel(points, scalars, n, &jacobian);
+    blst_p1_to_affine(result, &jacobian);
 }
@@ -1,11 +1,29 @@
 #ifndef CPU_MSM_H
 #define CPU_MSM_H
 
-#include <vector>
-
+#include "blst.h"
 #include "common.h"
 
-void cpu_msm(const std::vector<float>& points, const std::vector<float>& scalars,
-             std::vector<float>& result, const MsmParams& params);
+// cpu_msm_parallel with the result in affine form
+void cpu_msm(const blst_p1_affine* points, const blst_scalar* scalars, size_t n,
+             blst_p1_affine* result);
+
+// sum(scalars[i] * points[i]) for i < n with blst's serial Pippenger
+void cpu_msm_blst(const blst_p1_affine* points, const blst_scalar* scalars, size_t n,
+                  blst_p1* result);
+
+// Window size c of cpu_msm_parallel for n points on `threads` threads
+uint cpu_msm_window_bits(size_t n, uint threads);
+
+// sum(scalars[i] * points[i]) for i < n on every OpenMP thread: signed-digit windows split into
+// (window, point range) tasks, with affine buckets updated in batches that share one inversion
+void cpu_msm_parallel(const blst_p1_affine* points, const blst_scalar* scalars, size_t n,
+                      blst_p1* result);
+
+// The sort stages of msm.comp for one MSM on the CPU: `bucket_lists` receives the offsets and
+// entries of every window in the layout described in msm_sort.glsl, with each bucket's entries
+// in ascending point order
+void cpu_msm_sort_buckets(const blst_scalar* scalars, uint n, uint window_bits,
+                          uint32_t* bucket_lists);
 
 #endif  // CPU_MSM_H
@@ -0,0 +1,152 @@
+#include "cpu_ntt.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <iostream>
+
+// r - 1 as little-endian 64-bit limbs
+const uint64_t FR_MODULUS_MINUS_ONE[4] = {0xffffffff00000000ull, 0x53bda402fffe5bfeull,
+                                          0x3339d80809a1d805ull, 0x73eda753299d7d48ull};
+
+// Values per task when filling or applying power tables, each starting from one exponentiation
+const size_t NTT_POWER_CHUNK = 4096;
+
+static blst_fr fr_from_u64(uint64_t value) {
+    uint64_t limbs[4] = {value, 0, 0, 0};
+    blst_fr r;
+    blst_fr_from_uint64(&r, limbs);
+    return r;
+}
+
+static blst_fr fr_pow(const blst_fr& base, const uint64_t exponent[4]) {
+    blst_fr acc = fr_from_u64(1);
+    for (int bit = 255; bit >= 0; --bit) {
+        blst_fr_sqr(&acc, &acc);
+        if ((exponent[bit / 64] >> (bit % 64)) & 1) blst_fr_mul(&acc, &acc, &base);
+    }
+    return acc;
+}
+
+static blst_fr fr_pow(const blst_fr& base, uint64_t exponent) {
+    uint64_t limbs[4] = {exponent, 0, 0, 0};
+    return fr_pow(base, limbs);
+}
+
+// values[i] *= factor * base^i for i < n
+static void scale_by_powers(blst_fr* values, size_t n, const blst_fr& base,
+                            const blst_fr& factor) {
+    long chunks = (long)((n + NTT_POWER_CHUNK - 1) / NTT_POWER_CHUNK);
+#pragma omp parallel for schedule(static)
+    for (long c = 0; c < chunks; ++c) {
+        size_t begin = (size_t)c * NTT_POWER_CHUNK;
+        size_t end = std::min(n, begin + NTT_POWER_CHUNK);
+        blst_fr power = fr_pow(base, begin);
+        blst_fr_mul(&power, &power, &factor);
+        for (size_t i = begin; i < end; ++i) {
+            blst_fr_mul(&values[i], &values[i], &power);
+            blst_fr_mul(&power, &power, &base);
+        }
+    }
+}
+
+// base^i for i < count
+static std::vector<blst_fr> powers(const blst_fr& base, size_t count) {
+    std::vector<blst_fr> table(count, fr_from_u64(1));
+    scale_by_powers(table.data(), count, base, fr_from_u64(1));
+    return table;
+}
+
+NttDomain make_ntt_domain(uint log_n) {
+    if (log_n < 1 || log_n > NTT_MAX_SIZE_LOG_N) {
+        std::cerr << "NTT size 2^" << log_n << " outside 2^1 .. 2^" << NTT_MAX_SIZE_LOG_N
+                  << std::endl;
+        exit(1);
+    }
+    NttDomain domain;
+    domain.log_n = log_n;
+    domain.n = 1u << log_n;
+
+    // omega = g^((r - 1) / n) has order exactly n since g generates Fr*
+    uint64_t exponent[4];
+    for (int i = 0; i < 4; ++i) {
+        uint64_t next = i < 3 ? FR_MODULUS_MINUS_ONE[i + 1] : 0;
+        exponent[i] = (FR_MODULUS_MINUS_ONE[i] >> log_n) | (next << (63 - log_n) << 1);
+    }
+    domain.shift = fr_from_u64(NTT_GENERATOR);
+    domain.omega = fr_pow(domain.shift, exponent);
+    blst_fr_inverse(&domain.omega_inv, &domain.omega);
+    blst_fr n = fr_from_u64(domain.n);
+    blst_fr_inverse(&domain.n_inv, &n);
+    blst_fr_inverse(&domain.shift_inv, &domain.shift);
+    domain.twiddles = powers(domain.omega, domain.n / 2);
+    domain.inverse_twiddles = powers(domain.omega_inv, domain.n / 2);
+    return domain;
+}
+
+static uint reverse_bits(uint value, uint bits) {
+    uint r = 0;
+    for (uint i = 0; i < bits; ++i) r |= ((value >> i) & 1u) << (bits - 1 - i);
+    return r;
+}
+
+void cpu_ntt(blst_fr* values, const NttDomain& domain, bool inverse, bool coset) {
+    uint log_n = domain.log_n;
+    size_t n = domain.n;
+    if (coset && !inverse) scale_by_powers(values, n, domain.shift, fr_from_u64(1));
+
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long)n; ++i) {
+        uint j = reverse_bits((uint)i, log_n);
+        if ((uint)i < j) std::swap(values[i], values[j]);
+    }
+
+    const blst_fr* twiddles = inverse ? domain.inverse_twiddles.data() : domain.twiddles.data();
+    uint done = 0;  // log2 of the length of the sub-transforms completed so far
+    if (log_n & 1) {
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < (long)n; i += 2) {
+            blst_fr a = values[i];
+            blst_fr_add(&values[i], &a, &values[i + 1]);
+            blst_fr_sub(&values[i + 1], &a, &values[i + 1]);
+        }
+        done = 1;
+    }
+    // Four sub-transforms of length L become one of length 4L: the first radix-2 stage pairs
+    // them with omega_2L^j, the second with omega_4L^j and omega_4L^(j + L), all read from the
+    // omega_n table at stride n / 2L or n / 4L
+    for (; done < log_n; done += 2) {
+        size_t quarter = size_t(1) << done;
+        uint shift_2l = log_n - done - 1;
+        uint shift_4l = log_n - done - 2;
+#pragma omp parallel for schedule(static)
+        for (long t = 0; t < (long)(n / 4); ++t) {
+            size_t j = (size_t)t & (quarter - 1);
+            size_t base = ((size_t)t >> done) * 4 * quarter + j;
+            blst_fr* v0 = &values[base];
+            blst_fr* v1 = v0 + quarter;
+            blst_fr* v2 = v1 + quarter;
+            blst_fr* v3 = v2 + quarter;
+
+            blst_fr t1, t3, b0, b1, b2, b3;
+            blst_fr_mul(&t1, v1, &twiddles[j << shift_2l]);
+            blst_fr_mul(&t3, v3, &twiddles[j << shift_2l]);
+            blst_fr_add(&b0, v0, &t1);
+            blst_fr_sub(&b1, v0, &t1);
+            blst_fr_add(&b2, v2, &t3);
+            blst_fr_sub(&b3, v2, &t3);
+
+            blst_fr t2, t4;
+            blst_fr_mul(&t2, &b2, &twiddles[j << shift_4l]);
+            blst_fr_mul(&t4, &b3, &twiddles[(j + quarter) << shift_4l]);
+            blst_fr_add(v0, &b0, &t2);
+            blst_fr_sub(v2, &b0, &t2);
+            blst_fr_add(v1, &b1, &t4);
+            blst_fr_sub(v3, &b1, &t4);
+        }
+    }
+
+    if (inverse) {
+        scale_by_powers(values, n, coset ? domain.shift_inv : fr_from_u64(1), domain.n_inv);
+    }
+}
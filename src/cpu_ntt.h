@@ -0,0 +1,35 @@
+#ifndef CPU_NTT_H
+#define CPU_NTT_H
+
+#include <vector>
+
+#include "blst.h"
+#include "common.h"
+
+// Multiplicative generator of Fr: the root of unity source and the shift of coset transforms
+const uint64_t NTT_GENERATOR = 7;
+
+// Subgroup H of the 2^log_n-th roots of unity that transforms of n = 2^log_n values evaluate
+// over, with the coset shift and the twiddle tables of both directions
+struct NttDomain {
+    uint log_n = 0;
+    uint n = 0;
+    blst_fr omega;  // generates H
+    blst_fr omega_inv;
+    blst_fr n_inv;
+    blst_fr shift;  // cosets are shift * H
+    blst_fr shift_inv;
+    std::vector<blst_fr> twiddles;          // omega^j for j < n / 2
+    std::vector<blst_fr> inverse_twiddles;  // omega^-j for j < n / 2
+};
+
+// 1 <= log_n <= NTT_MAX_SIZE_LOG_N
+NttDomain make_ntt_domain(uint log_n);
+
+// In-place transform of domain.n values in natural order on every OpenMP thread: a bit-reversal
+// permutation, then radix-4 passes that each fuse two radix-2 stages, with one radix-2 pass first
+// when log_n is odd. The forward transform evaluates the polynomial with coefficients `values` at
+// omega^k (at shift * omega^k for a coset); the inverse interpolates back.
+void cpu_ntt(blst_fr* values, const NttDomain& domain, bool inverse, bool coset);
+
+#endif  // CPU_NTT_H
@@ -0,0 +1,65 @@
+#include "device_points.h"
+
+#include <algorithm>
+#include <chrono>
+
+void DevicePoints::init(VulkanCompute& vk_ref, uint points) {
+    vk = &vk_ref;
+    count = points;
+    plan = MsmPlan(*vk, points);
+    buffer = vk->createStorageBuffer(plan.points_size());
+
+    kernel.init(*vk, POINTS_SHADER, POINTS_BINDINGS, sizeof(PointsParams));
+    kernel.bindResident(1, buffer);
+    init_msm_kernel(msm, *vk);
+    msm.bindResident(0, buffer);
+}
+
+// Clear the invalid count, then run `stage` with one invocation per point over a 2D grid past the
+// device's workgroup count limit, and wait for it
+static uint convert(DevicePoints& dp, uint stage, const void* words, size_t size) {
+    uint groups = std::max(1u, (dp.count + POINTS_WORKGROUP_SIZE - 1) / POINTS_WORKGROUP_SIZE);
+    uint groups_x = std::min(groups, dp.vk->limits.maxComputeWorkGroupCount[0]);
+    uint groups_y = (groups + groups_x - 1) / groups_x;
+    PointsParams clear = {dp.count, POINTS_STAGE_CLEAR};
+    PointsParams params = {dp.count, stage};
+    std::vector<VulkanStage> stages = {
+        {&clear, sizeof(PointsParams), 1, 1, 1},
+        {&params, sizeof(PointsParams), groups_x, groups_y, 1},
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    uint invalid = 0;
+    std::vector<void*> inputs = {(void*)words, nullptr};
+    std::vector<size_t> input_sizes = {size, 0};
+    dp.kernel.submit(stages, inputs, input_sizes, {}, &invalid, sizeof(invalid)).wait();
+    auto end = std::chrono::high_resolution_clock::now();
+    dp.upload_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    return invalid;
+}
+
+void DevicePoints::load_affine(const blst_p1_affine* points) {
+    convert(*this, POINTS_STAGE_TRANSPOSE, points, (size_t)count * sizeof(blst_p1_affine));
+}
+
+uint DevicePoints::load_compressed(const byte* compressed) {
+    return convert(*this, POINTS_STAGE_DECOMPRESS, compressed,
+                   (size_t)count * G1_COMPRESSED_WORDS * sizeof(uint32_t));
+}
+
+ComputeJob DevicePoints::submit(const blst_scalar* scalars, blst_p1* result) {
+    std::vector<void*> inputs = {nullptr, (void*)scalars};
+    std::vector<size_t> input_sizes = {0, plan.scalars_size()};
+    return msm.submit(plan.stages(), inputs, input_sizes, plan.scratch_sizes, result,
+                      sizeof(blst_p1));
+}
+
+void DevicePoints::download(uint32_t* soa) {
+    vk->download(buffer, soa, plan.points_size());
+}
+
+void DevicePoints::destroy() {
+    kernel.destroy();
+    msm.destroy();
+    vk->destroyBuffer(buffer);
+}
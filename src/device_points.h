@@ -0,0 +1,43 @@
+#ifndef DEVICE_POINTS_H
+#define DEVICE_POINTS_H
+
+#include "blst.h"
+#include "common.h"
+#include "gpu_msm.h"
+#include "vulkan_helper.h"
+
+#define POINTS_SHADER "build/g1_points.spv"
+
+// g1_points.comp bindings: input words, point table, invalid count
+const uint32_t POINTS_BINDINGS = 3;
+
+// A set of G1 points kept on the device in the layout msm.comp reads. The points are uploaded
+// once, either in blst's affine layout or compressed to half the bytes, and converted there by
+// g1_points.comp; each submit() then runs an MSM over them uploading only the scalars.
+struct DevicePoints {
+    VulkanCompute* vk = nullptr;
+    ComputeKernel kernel;
+    ComputeKernel msm;
+    MsmPlan plan;
+    GpuBuffer buffer;
+    uint count = 0;
+    double upload_ms = 0.0;  // the last load, copy and conversion
+
+    void init(VulkanCompute& vk_ref, uint points);
+
+    void load_affine(const blst_p1_affine* points);
+
+    // Decompresses `count` 48-byte encodings without subgroup checks and returns how many were
+    // invalid; those become the point at infinity
+    uint load_compressed(const byte* compressed);
+
+    // `result` receives a Jacobian point in blst's limb layout once the job completes
+    ComputeJob submit(const blst_scalar* scalars, blst_p1* result);
+
+    // The table in the device layout, G1_SOA_WORDS * count words
+    void download(uint32_t* soa);
+
+    void destroy();
+};
+
+#endif  // DEVICE_POINTS_H
@@ -0,0 +1,19 @@
+#ifndef EMBEDDED_SHADERS_H
+#define EMBEDDED_SHADERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SPIR-V compiled into the executable. CMake's compile_shader emits each shader as an array and
+// generates the table (embedded_shaders.cpp in the build directory), so the benchmark does not
+// depend on the working directory to find its shaders.
+struct EmbeddedShader {
+    const char* path;  // the path the shader is also written to, e.g. "build/msm.spv"
+    const uint32_t* code;
+    size_t size;  // bytes
+};
+
+extern const EmbeddedShader EMBEDDED_SHADERS[];
+extern const size_t EMBEDDED_SHADER_COUNT;
+
+#endif  // EMBEDDED_SHADERS_H
@@ -0,0 +1,424 @@
+#include "field_check.h"
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "blst.h"
+#include "bls12_381_g1.h"
+#include "point_layout.h"
+
+// The shared types are blst's, limb for limb, so values pass between them unconverted
+static_assert(sizeof(Fp) == sizeof(blst_fp), "Fp must match blst_fp");
+static_assert(sizeof(Fr) == sizeof(blst_fr), "Fr must match blst_fr");
+static_assert(sizeof(G1Affine) == sizeof(blst_p1_affine), "G1Affine must match blst_p1_affine");
+static_assert(sizeof(G1Jacobian) == sizeof(blst_p1), "G1Jacobian must match blst_p1");
+
+// Distinct points the G1 checks draw operands from; a scalar multiplication per input would
+// dominate the run
+const size_t FIELD_CHECK_POINTS = 4096;
+// Multiplications per timed pass and passes per timing
+const size_t FIELD_BENCH_MULS = 1 << 16;
+const uint FIELD_BENCH_PASSES = 16;
+
+static const blst_fp* as_blst(const Fp& a) { return reinterpret_cast<const blst_fp*>(&a); }
+static const blst_fr* as_blst(const Fr& a) { return reinterpret_cast<const blst_fr*>(&a); }
+static const blst_p1* as_blst(const G1Jacobian& p) { return reinterpret_cast<const blst_p1*>(&p); }
+static const blst_p1_affine* as_blst(const G1Affine& p) {
+    return reinterpret_cast<const blst_p1_affine*>(&p);
+}
+
+template <typename A, typename B>
+static bool same_bits(const A& a, const B& b) {
+    static_assert(sizeof(A) == sizeof(B), "compared values differ in size");
+    return memcmp(&a, &b, sizeof(A)) == 0;
+}
+
+// Stateless generator, so the inputs of check i do not depend on which thread runs it
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Random reduced value, read as a Montgomery form directly. Seeds 0, 1 and 2 give the edge cases
+// 0, 1 and modulus - 1.
+template <typename F>
+static F random_element(uint64_t seed, const uint* modulus, const F& one) {
+    const uint limbs = sizeof(F) / sizeof(uint);
+    F r;
+    uint64_t state = seed;
+    for (uint i = 0; i < limbs; ++i) {
+        state = splitmix64(state);
+        r.l[i] = (uint)state;
+    }
+    r.l[limbs - 1] %= modulus[limbs - 1];
+    if (seed == 0) {
+        for (uint i = 0; i < limbs; ++i) r.l[i] = 0;
+    } else if (seed == 1) {
+        r = one;
+    } else if (seed == 2) {
+        for (uint i = 0; i < limbs; ++i) r.l[i] = modulus[i];
+        r.l[0] -= 1;  // both moduli are odd
+    }
+    return r;
+}
+
+static Fp random_fp(uint64_t seed) {
+    return random_element(seed, FP_MODULUS, fp_one());
+}
+
+static Fr random_fr(uint64_t seed) {
+    static const Fr one = [] {
+        uint64_t limbs[4] = {1, 0, 0, 0};
+        blst_fr r;
+        blst_fr_from_uint64(&r, limbs);
+        Fr f;
+        memcpy(&f, &r, sizeof(f));
+        return f;
+    }();
+    return random_element(seed, FR_MODULUS, one);
+}
+
+// Runs check(i) for i < count on every OpenMP thread and reports the number that failed
+template <typename Check>
+static size_t count_mismatches(const char* name, size_t count, Check check) {
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t mismatches = 0;
+#pragma omp parallel for schedule(static) reduction(+ : mismatches)
+    for (long i = 0; i < (long)count; ++i) mismatches += check((uint64_t)i) ? 0 : 1;
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "  " << name << ": "
+              << (mismatches == 0 ? "ok" : std::to_string(mismatches) + " mismatches") << " ("
+              << std::chrono::duration<double>(end - start).count() << " s)" << std::endl;
+    return mismatches;
+}
+
+// Seed of operand 0 or 1 of check i: the first nine checks pair up the edge cases, the rest draw
+// each operand from its own stream
+static uint64_t operand_seed(uint64_t i, uint operand) {
+    if (i < 9) return operand == 0 ? i / 3 : i % 3;
+    return splitmix64(i * 2 + operand);
+}
+
+template <typename F, typename B>
+static size_t check_binary(const char* name, size_t count, F (*random)(uint64_t), F (*shared)(F, F),
+                           void (*reference)(B*, const B*, const B*)) {
+    return count_mismatches(name, count, [&](uint64_t i) {
+        F a = random(operand_seed(i, 0));
+        F b = random(operand_seed(i, 1));
+        B expected;
+        reference(&expected, as_blst(a), as_blst(b));
+        return same_bits(shared(a, b), expected);
+    });
+}
+
+template <typename F, typename B>
+static size_t check_unary(const char* name, size_t count, F (*random)(uint64_t), F (*shared)(F),
+                          void (*reference)(B*, const B*)) {
+    return count_mismatches(name, count, [&](uint64_t i) {
+        F a = random(operand_seed(i, 0));
+        B expected;
+        reference(&expected, as_blst(a));
+        return same_bits(shared(a), expected);
+    });
+}
+
+struct PointPool {
+    std::vector<G1Jacobian> jacobian;  // multiples of the generator, with Z != 1
+    std::vector<G1Affine> affine;      // the same points
+};
+
+static PointPool make_point_pool(size_t size) {
+    PointPool pool;
+    pool.jacobian.resize(size);
+    pool.affine.resize(size);
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long)size; ++i) {
+        byte scalar[32];
+        for (int j = 0; j < 32; j += 8) {
+            uint64_t bits = splitmix64((uint64_t)i * 4 + j / 8);
+            memcpy(scalar + j, &bits, 8);
+        }
+        blst_p1 p;
+        blst_p1_mult(&p, blst_p1_generator(), scalar, 255);
+        blst_p1_affine a;
+        blst_p1_to_affine(&a, &p);
+        memcpy(&pool.jacobian[i], &p, sizeof(p));
+        memcpy(&pool.affine[i], &a, sizeof(a));
+    }
+    return pool;
+}
+
+struct PointOperands {
+    G1Jacobian p;
+    G1Jacobian q;
+    G1Affine q_affine;  // q with Z = 1, so p + q_affine meets p in a different representation
+};
+
+// Operands of point check i: two pool points, except that every eighth check adds a point to
+// itself, to its negation, to infinity, or infinity to it
+static PointOperands point_operands(const PointPool& pool, uint64_t i) {
+    size_t a = splitmix64(i * 2) % pool.jacobian.size();
+    size_t b = i % 8 < 2 ? a : splitmix64(i * 2 + 1) % pool.jacobian.size();
+    PointOperands ops = {pool.jacobian[a], pool.jacobian[b], pool.affine[b]};
+    if (i % 8 == 1) {
+        ops.q.y = fp_sub(fp_zero(), ops.q.y);
+        ops.q_affine = g1_neg_affine(ops.q_affine);
+    } else if (i % 8 == 2) {
+        ops.q = g1_infinity();
+        ops.q_affine.x = fp_zero();
+        ops.q_affine.y = fp_zero();
+    } else if (i % 8 == 3) {
+        ops.p = g1_infinity();
+    }
+    return ops;
+}
+
+// Encoding of decompression check i: a compressed pool point, except that every eighth check
+// takes infinity (with a stray sign flag every other time), drops the compression flag, sets an x
+// of p or above, changes x to one on or off the curve, or flips the sign of y
+static void compressed_operand(const PointPool& pool, uint64_t i, byte encoded[48]) {
+    size_t a = splitmix64(i) % pool.affine.size();
+    blst_p1_affine_compress(encoded, as_blst(pool.affine[a]));
+    if (i % 8 == 2) {
+        memset(encoded, 0, 48);
+        encoded[0] = (i / 8) % 2 ? 0xe0 : 0xc0;
+    } else if (i % 8 == 3) {
+        encoded[0] &= 0x7f;
+    } else if (i % 8 == 4) {
+        encoded[0] |= 0x1f;  // the top byte of p is 0x1a
+    } else if (i % 8 == 5) {
+        encoded[47] ^= 1;
+    } else if (i % 8 == 6) {
+        encoded[0] ^= 0x20;
+    }
+}
+
+static bool same_point(const G1Jacobian& result, const blst_p1& expected) {
+    return blst_p1_is_equal(as_blst(result), &expected);
+}
+
+static size_t check_points(size_t count) {
+    std::cout << "G1 (" << FIELD_CHECK_POINTS << " distinct points)" << std::endl;
+    PointPool pool = make_point_pool(FIELD_CHECK_POINTS);
+    size_t failures = 0;
+    failures += count_mismatches("g1_dbl", count, [&](uint64_t i) {
+        PointOperands ops = point_operands(pool, i);
+        blst_p1 expected;
+        blst_p1_double(&expected, as_blst(ops.p));
+        return same_point(g1_dbl(ops.p), expected);
+    });
+    failures += count_mismatches("g1_add", count, [&](uint64_t i) {
+        PointOperands ops = point_operands(pool, i);
+        blst_p1 expected;
+        blst_p1_add_or_double(&expected, as_blst(ops.p), as_blst(ops.q));
+        return same_point(g1_add(ops.p, ops.q), expected);
+    });
+    failures += count_mismatches("g1_add_affine", count, [&](uint64_t i) {
+        PointOperands ops = point_operands(pool, i);
+        blst_p1 expected;
+        blst_p1_add_or_double_affine(&expected, as_blst(ops.p), as_blst(ops.q_affine));
+        return same_point(g1_add_affine(ops.p, ops.q_affine), expected);
+    });
+    failures += count_mismatches("g1_xyzz_dbl", count, [&](uint64_t i) {
+        PointOperands ops = point_operands(pool, i);
+        blst_p1 expected;
+        blst_p1_double(&expected, as_blst(ops.p));
+        G1Xyzz r = g1_xyzz_dbl(g1_xyzz_from_jacobian(ops.p));
+        return same_point(g1_xyzz_to_jacobian(r), expected);
+    });
+    failures += count_mismatches("g1_xyzz_add", count, [&](uint64_t i) {
+        PointOperands ops = point_operands(pool, i);
+        blst_p1 expected;
+        blst_p1_add_or_double(&expected, as_blst(ops.p), as_blst(ops.q));
+        G1Xyzz r = g1_xyzz_add(g1_xyzz_from_jacobian(ops.p), g1_xyzz_from_jacobian(ops.q));
+        return same_point(g1_xyzz_to_jacobian(r), expected);
+    });
+    failures += count_mismatches("g1_xyzz_add_affine", count, [&](uint64_t i) {
+        PointOperands ops = point_operands(pool, i);
+        blst_p1 expected;
+        blst_p1_add_or_double_affine(&expected, as_blst(ops.p), as_blst(ops.q_affine));
+        G1Xyzz r = g1_xyzz_add_affine(g1_xyzz_from_jacobian(ops.p), ops.q_affine);
+        return same_point(g1_xyzz_to_jacobian(r), expected);
+    });
+    failures += count_mismatches("g1_decompress", count, [&](uint64_t i) {
+        byte encoded[48];
+        compressed_operand(pool, i, encoded);
+        blst_p1_affine expected;
+        bool valid = blst_p1_uncompress(&expected, encoded) == BLST_SUCCESS;
+        // The words g1_points.comp loads: the encoding's bytes in little-endian 32-bit groups
+        Fp words;
+        memcpy(&words, encoded, sizeof(words));
+        G1Affine p;
+        if (g1_decompress(g1_compressed_x(words), p) != valid) return false;
+        return !valid || same_bits(p, expected);
+    });
+    // The AVX2 transpose against word-by-word copies, over whole blocks of eight and a tail
+    failures += count_mismatches("g1_points_to_soa", 2, [&](uint64_t i) {
+        size_t n = pool.affine.size() - i * 3;
+        std::vector<uint32_t> soa(n * G1_SOA_WORDS);
+        g1_points_to_soa(as_blst(pool.affine[0]), n, soa.data());
+        for (size_t k = 0; k < n; ++k) {
+            for (uint w = 0; w < G1_SOA_WORDS; ++w) {
+                uint word = w < FP_LIMBS ? pool.affine[k].x.l[w] : pool.affine[k].y.l[w - FP_LIMBS];
+                if (soa[g1_soa_index((uint)n, (uint)k, w)] != word) return false;
+            }
+        }
+        return true;
+    });
+    return failures;
+}
+
+// Four fp_mul at once, one per 64-bit lane: the same CIOS loop with every 32 x 32-bit limb product
+// from _mm256_mul_epu32 and the carry in the upper half of the lane, then the final subtraction
+// of p as a borrow chain and a blend. Operands are lane-interleaved, limb j of lane k at
+// [4 * j + k].
+static void fp_mul_x4_avx2(const uint* a, const uint* b, uint* r) {
+    const __m256i mask = _mm256_set1_epi64x(0xffffffff);
+    const __m256i inv = _mm256_set1_epi64x(FP_INV);
+    __m256i av[FP_LIMBS];
+    __m256i t[FP_LIMBS + 2];
+    for (uint j = 0; j < FP_LIMBS; ++j) {
+        av[j] = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(a + 4 * j)));
+    }
+    for (uint j = 0; j < FP_LIMBS + 2; ++j) t[j] = _mm256_setzero_si256();
+
+    for (uint i = 0; i < FP_LIMBS; ++i) {
+        __m256i bi = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(b + 4 * i)));
+        __m256i c = _mm256_setzero_si256();
+        for (uint j = 0; j < FP_LIMBS; ++j) {
+            __m256i p = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(av[j], bi), t[j]), c);
+            t[j] = _mm256_and_si256(p, mask);
+            c = _mm256_srli_epi64(p, 32);
+        }
+        __m256i s = _mm256_add_epi64(t[FP_LIMBS], c);
+        t[FP_LIMBS] = _mm256_and_si256(s, mask);
+        t[FP_LIMBS + 1] = _mm256_srli_epi64(s, 32);
+
+        __m256i m = _mm256_and_si256(_mm256_mul_epu32(t[0], inv), mask);
+        __m256i p = _mm256_add_epi64(_mm256_mul_epu32(m, _mm256_set1_epi64x(FP_MODULUS[0])), t[0]);
+        c = _mm256_srli_epi64(p, 32);
+        for (uint j = 1; j < FP_LIMBS; ++j) {
+            __m256i modulus = _mm256_set1_epi64x(FP_MODULUS[j]);
+            p = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(m, modulus), t[j]), c);
+            t[j - 1] = _mm256_and_si256(p, mask);
+            c = _mm256_srli_epi64(p, 32);
+        }
+        s = _mm256_add_epi64(t[FP_LIMBS], c);
+        t[FP_LIMBS - 1] = _mm256_and_si256(s, mask);
+        t[FP_LIMBS] = _mm256_add_epi64(t[FP_LIMBS + 1], _mm256_srli_epi64(s, 32));
+    }
+
+    // As fp_reduce_once: keep t where t - p borrows past the carry t[FP_LIMBS]
+    __m256i d[FP_LIMBS];
+    __m256i borrow = _mm256_setzero_si256();
+    for (uint j = 0; j < FP_LIMBS; ++j) {
+        __m256i x = _mm256_sub_epi64(_mm256_sub_epi64(t[j], _mm256_set1_epi64x(FP_MODULUS[j])),
+                                     borrow);
+        d[j] = _mm256_and_si256(x, mask);
+        borrow = _mm256_srli_epi64(x, 63);
+    }
+    __m256i keep = _mm256_cmpgt_epi64(borrow, t[FP_LIMBS]);
+    const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+    for (uint j = 0; j < FP_LIMBS; ++j) {
+        __m256i v = _mm256_blendv_epi8(d[j], t[j], keep);
+        v = _mm256_permutevar8x32_epi32(v, low_halves);
+        _mm_storeu_si128((__m128i*)(r + 4 * j), _mm256_castsi256_si128(v));
+    }
+}
+
+// Groups of four values in the lane-interleaved layout of fp_mul_x4_avx2
+static std::vector<uint> interleave(const std::vector<Fp>& values) {
+    std::vector<uint> lanes(values.size() * FP_LIMBS);
+    for (size_t i = 0; i < values.size(); ++i) {
+        for (uint j = 0; j < FP_LIMBS; ++j) {
+            lanes[(i / 4 * FP_LIMBS + j) * 4 + i % 4] = values[i].l[j];
+        }
+    }
+    return lanes;
+}
+
+static Fp deinterleave(const std::vector<uint>& lanes, size_t i) {
+    Fp r;
+    for (uint j = 0; j < FP_LIMBS; ++j) r.l[j] = lanes[(i / 4 * FP_LIMBS + j) * 4 + i % 4];
+    return r;
+}
+
+// Millions of multiplications per second of `pass` over FIELD_BENCH_MULS pairs on one thread
+template <typename Pass>
+static double mul_rate(Pass pass) {
+    pass();  // warm up
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint k = 0; k < FIELD_BENCH_PASSES; ++k) pass();
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return FIELD_BENCH_MULS * FIELD_BENCH_PASSES / seconds / 1e6;
+}
+
+// Times Fp multiplication three ways and checks the AVX2 results against the shared code
+static size_t benchmark_fp_mul() {
+    std::vector<Fp> a(FIELD_BENCH_MULS), b(FIELD_BENCH_MULS), shared(FIELD_BENCH_MULS);
+    for (size_t i = 0; i < FIELD_BENCH_MULS; ++i) {
+        a[i] = random_fp(operand_seed(i, 0));
+        b[i] = random_fp(operand_seed(i, 1));
+    }
+    std::vector<blst_fp> reference(FIELD_BENCH_MULS);
+    std::vector<uint> a_lanes = interleave(a), b_lanes = interleave(b);
+    std::vector<uint> r_lanes(a_lanes.size());
+
+    double shared_rate = mul_rate([&] {
+        for (size_t i = 0; i < FIELD_BENCH_MULS; ++i) shared[i] = fp_mul(a[i], b[i]);
+    });
+    double blst_rate = mul_rate([&] {
+        for (size_t i = 0; i < FIELD_BENCH_MULS; ++i) {
+            blst_fp_mul(&reference[i], as_blst(a[i]), as_blst(b[i]));
+        }
+    });
+    double avx2_rate = mul_rate([&] {
+        for (size_t g = 0; g < FIELD_BENCH_MULS / 4; ++g) {
+            size_t offset = g * 4 * FP_LIMBS;
+            fp_mul_x4_avx2(&a_lanes[offset], &b_lanes[offset], &r_lanes[offset]);
+        }
+    });
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < FIELD_BENCH_MULS; ++i) {
+        if (!same_bits(deinterleave(r_lanes, i), shared[i])) ++mismatches;
+    }
+    std::cout << "Fp multiplication, one thread (M mul/s): shared " << shared_rate << ", blst "
+              << blst_rate << ", AVX2 4-lane " << avx2_rate;
+    if (mismatches > 0) std::cout << " (" << mismatches << " AVX2 mismatches)";
+    std::cout << std::endl;
+    return mismatches;
+}
+
+bool run_field_check(size_t count) {
+    std::cout << "Checking shared field arithmetic against blst on " << count << " inputs per "
+              << "operation, " << omp_get_max_threads() << " threads" << std::endl;
+    size_t failures = 0;
+    std::cout << "Fp" << std::endl;
+    failures += check_binary("fp_add", count, random_fp, fp_add, blst_fp_add);
+    failures += check_binary("fp_sub", count, random_fp, fp_sub, blst_fp_sub);
+    failures += check_binary("fp_mul", count, random_fp, fp_mul, blst_fp_mul);
+    failures += check_unary("fp_sqr", count, random_fp, fp_sqr, blst_fp_sqr);
+    std::cout << "Fr" << std::endl;
+    failures += check_binary("fr_add", count, random_fr, fr_add, blst_fr_add);
+    failures += check_binary("fr_sub", count, random_fr, fr_sub, blst_fr_sub);
+    failures += check_binary("fr_mul", count, random_fr, fr_mul, blst_fr_mul);
+    failures += check_unary("fr_sqr", count, random_fr, fr_sqr, blst_fr_sqr);
+    failures += check_points(count);
+    failures += benchmark_fp_mul();
+
+    if (failures == 0)
+        std::cout << "All results match blst" << std::endl;
+    else
+        std::cerr << failures << " results differ from blst" << std::endl;
+    return failures == 0;
+}
@@ -0,0 +1,14 @@
+#ifndef FIELD_CHECK_H
+#define FIELD_CHECK_H
+
+#include <cstddef>
+
+// Host-side check of the arithmetic the shaders share with C++ (bls12_381_field.h,
+// bls12_381_g1.h): runs every Fp, Fr and G1 operation on `count` random inputs, including the
+// doubling, inverse and infinity cases of point addition and invalid compressed encodings, and
+// compares each result with blst, then checks the host conversion to the device point layout.
+// Then times Fp multiplication as the shared C++, blst, and a 4-lane AVX2 multi-limb kernel.
+// Needs no GPU; returns whether every result matched.
+bool run_field_check(size_t count);
+
+#endif  // FIELD_CHECK_H
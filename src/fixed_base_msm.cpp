@@ -0,0 +1,162 @@
+#include "fixed_base_msm.h"
+
+#include <omp.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Upper bound on the table, on top of maxStorageBufferRange
+const uint64_t FIXED_BASE_TABLE_MAX_BYTES = uint64_t(512) << 20;
+
+const char FIXED_BASE_MAGIC[8] = {'V', 'G', 'C', 'F', 'B', 'T', '0', '1'};
+
+struct FixedBaseHeader {
+    char magic[8];
+    uint32_t points;
+    uint32_t window_bits;
+    uint32_t num_windows;
+    uint32_t windows_per_group;
+    uint64_t bases_hash;
+};
+
+// FNV-1a over the bases' bytes
+static uint64_t hash_bases(const blst_p1_affine* bases, uint points) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(bases);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < (size_t)points * sizeof(blst_p1_affine); ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint fixed_base_windows_per_group(uint points, uint64_t max_bytes) {
+    MsmPlan plan(points);
+    uint num_windows = plan.params.num_windows;
+    for (uint per_group = 1; per_group <= num_windows; ++per_group) {
+        uint64_t groups = (num_windows + per_group - 1) / per_group;
+        if (groups * points * sizeof(blst_p1_affine) <= max_bytes) return per_group;
+    }
+    return 0;
+}
+
+FixedBaseTable build_fixed_base_table(const blst_p1_affine* bases, uint points,
+                                      uint windows_per_group) {
+    MsmPlan plan(points, windows_per_group);
+    FixedBaseTable table;
+    table.points = points;
+    table.window_bits = plan.params.window_bits;
+    table.num_windows = plan.params.num_windows;
+    table.windows_per_group = plan.params.windows_per_group;
+    table.bases_hash = hash_bases(bases, points);
+
+    uint groups = plan.num_groups();
+    uint doublings = table.windows_per_group * table.window_bits;
+    table.entries.resize((size_t)groups * points);
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long)points; ++i) {
+        blst_p1 q;
+        blst_p1_from_affine(&q, &bases[i]);
+        table.entries[i] = bases[i];
+        for (uint g = 1; g < groups; ++g) {
+            for (uint d = 0; d < doublings; ++d) blst_p1_double(&q, &q);
+            blst_p1_to_affine(&table.entries[(size_t)g * points + i], &q);
+        }
+    }
+    return table;
+}
+
+bool save_fixed_base_table(const std::string& path, const FixedBaseTable& table) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    FixedBaseHeader header;
+    memcpy(header.magic, FIXED_BASE_MAGIC, sizeof(header.magic));
+    header.points = table.points;
+    header.window_bits = table.window_bits;
+    header.num_windows = table.num_windows;
+    header.windows_per_group = table.windows_per_group;
+    header.bases_hash = table.bases_hash;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.entries.data()),
+               table.entries.size() * sizeof(blst_p1_affine));
+    return file.good();
+}
+
+bool load_fixed_base_table(const std::string& path, const blst_p1_affine* bases, uint points,
+                           uint windows_per_group, FixedBaseTable* table) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    FixedBaseHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+    MsmPlan plan(points, windows_per_group);
+    if (memcmp(header.magic, FIXED_BASE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.points != points || header.window_bits != plan.params.window_bits ||
+        header.num_windows != plan.params.num_windows ||
+        header.windows_per_group != plan.params.windows_per_group ||
+        header.bases_hash != hash_bases(bases, points)) {
+        return false;
+    }
+
+    table->points = header.points;
+    table->window_bits = header.window_bits;
+    table->num_windows = header.num_windows;
+    table->windows_per_group = header.windows_per_group;
+    table->bases_hash = header.bases_hash;
+    table->entries.resize((size_t)plan.num_groups() * points);
+    return (bool)file.read(reinterpret_cast<char*>(table->entries.data()),
+                           table->entries.size() * sizeof(blst_p1_affine));
+}
+
+void FixedBaseMsm::init(VulkanCompute& vk_ref, const blst_p1_affine* bases, uint points,
+                        const std::string& cache_path) {
+    vk = &vk_ref;
+    uint64_t max_bytes =
+        std::min<uint64_t>(vk->limits.maxStorageBufferRange, FIXED_BASE_TABLE_MAX_BYTES);
+    uint windows_per_group = fixed_base_windows_per_group(points, max_bytes);
+    if (windows_per_group == 0) {
+        std::cerr << points << " fixed bases exceed the " << max_bytes
+                  << "-byte table limit even as a single group" << std::endl;
+        exit(1);
+    }
+    plan = MsmPlan(*vk, points, windows_per_group);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    FixedBaseTable table;
+    loaded_from_cache = !cache_path.empty() &&
+                        load_fixed_base_table(cache_path, bases, points, windows_per_group, &table);
+    if (!loaded_from_cache) {
+        table = build_fixed_base_table(bases, points, windows_per_group);
+        if (!cache_path.empty() && !save_fixed_base_table(cache_path, table)) {
+            std::cerr << "Failed to write fixed-base table " << cache_path << std::endl;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    precompute_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    // The cached table stays in blst's layout; the device reads each group limb-major
+    start = std::chrono::high_resolution_clock::now();
+    AlignedVector<uint32_t> device_table = msm_device_points(plan, table.entries.data());
+    VkDeviceSize table_size = plan.points_size();
+    table_buffer = vk->createStorageBuffer(table_size);
+    vk->upload(table_buffer, device_table.data(), table_size);
+    vk->staging.flush();
+    end = std::chrono::high_resolution_clock::now();
+    upload_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    init_msm_kernel(kernel, *vk);
+    kernel.bindResident(0, table_buffer);
+}
+
+ComputeJob FixedBaseMsm::submit(const blst_scalar* scalars, blst_p1* result) {
+    std::vector<void*> inputs = {nullptr, (void*)scalars};
+    std::vector<size_t> input_sizes = {0, plan.scalars_size()};
+    return kernel.submit(plan.stages(), inputs, input_sizes, plan.scratch_sizes, result,
+                         sizeof(blst_p1));
+}
+
+void FixedBaseMsm::destroy() {
+    kernel.destroy();
+    vk->destroyBuffer(table_buffer);
+}
@@ -0,0 +1,58 @@
+#ifndef FIXED_BASE_MSM_H
+#define FIXED_BASE_MSM_H
+
+#include <string>
+#include <vector>
+
+#include "blst.h"
+#include "common.h"
+#include "gpu_msm.h"
+#include "vulkan_helper.h"
+
+// Shifted copies of a fixed set of bases for msm.comp: group g holds every base times
+// 2^(g * windows_per_group * window_bits), so windows of different groups need no doublings
+// between them
+struct FixedBaseTable {
+    uint points = 0;
+    uint window_bits = 0;
+    uint num_windows = 0;
+    uint windows_per_group = 0;
+    uint64_t bases_hash = 0;              // identifies the bases the table was built from
+    std::vector<blst_p1_affine> entries;  // [group][point]
+};
+
+// Smallest windows_per_group whose table of `points` bases fits in `max_bytes`, or 0 when not
+// even a single group of them does
+uint fixed_base_windows_per_group(uint points, uint64_t max_bytes);
+
+FixedBaseTable build_fixed_base_table(const blst_p1_affine* bases, uint points,
+                                      uint windows_per_group);
+
+bool save_fixed_base_table(const std::string& path, const FixedBaseTable& table);
+
+// False when the file is missing, unreadable, or was built from other bases or parameters
+bool load_fixed_base_table(const std::string& path, const blst_p1_affine* bases, uint points,
+                           uint windows_per_group, FixedBaseTable* table);
+
+// MSM over bases that stay the same from call to call, such as a commitment key. init() builds
+// (or loads from `cache_path`) the shifted-base table once and keeps it resident on the device;
+// each submit() then uploads only the scalars.
+struct FixedBaseMsm {
+    VulkanCompute* vk = nullptr;
+    ComputeKernel kernel;
+    MsmPlan plan;
+    GpuBuffer table_buffer;
+    double precompute_ms = 0.0;  // building or loading the table
+    double upload_ms = 0.0;      // copying it to the device
+    bool loaded_from_cache = false;
+
+    void init(VulkanCompute& vk_ref, const blst_p1_affine* bases, uint points,
+              const std::string& cache_path = "");
+
+    // `result` receives a Jacobian point in blst's limb layout once the job completes
+    ComputeJob submit(const blst_scalar* scalars, blst_p1* result);
+
+    void destroy();
+};
+
+#endif  // FIXED_BASE_MSM_H
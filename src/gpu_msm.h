@@ -0,0 +1,284 @@
+#ifndef GPU_MSM_H
+#define GPU_MSM_H
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "blst.h"
+#include "common.h"
+#include "point_layout.h"
+#include "vulkan_helper.h"
+
+#define MSM_SHADER "build/msm.spv"
+#define MSM_REDUCE_SHADER "build/msm_reduce.spv"
+#define MSM_REDUCE_SUBGROUP_SHADER "build/msm_reduce_subgroup.spv"
+#define MSM_SORT_SHADER "build/msm_sort.spv"
+
+// msm.comp bindings: points, scalars, bucket lists, buckets, window sums, result
+const uint32_t MSM_BINDINGS = 6;
+
+// The REDUCE stage runs msm.comp built as msm_reduce_shader(), the MSM kernel's stage shader
+const uint32_t MSM_REDUCE_PIPELINE = 1;
+
+// msm_sort.comp bindings: scalars, bucket lists
+const uint32_t MSM_SORT_BINDINGS = 2;
+
+// Window size c for the GPU bucket method. With sorted bucket lists the point additions shrink
+// with 1/c, while the serial running sum of each window grows with 2^(c-1).
+inline uint msm_window_bits(uint points) {
+    uint log2n = 0;
+    while (log2n < 31 && (1u << (log2n + 1)) <= points) ++log2n;
+    return std::max(2u, std::min(10u, log2n / 2 + 2));
+}
+
+// Split points into segments so there are enough bucket invocations to fill the device. A batch
+// of MSMs already multiplies the invocations, so each MSM needs fewer segments.
+inline uint msm_segments(uint points, uint batch = 1) {
+    return std::max(1u, std::min(64u, points / 4096) / std::max(1u, batch));
+}
+
+// Parameters, stage dispatches and scratch sizes of msm.comp for `batch` MSMs of one point count.
+// All MSMs of a batch run in the same dispatches and share one bucket buffer.
+struct MsmPlan {
+    MsmParams params;
+    MsmParams stage_params[MSM_STAGES];  // params with .stage set, one per stage
+    std::vector<size_t> scratch_sizes;
+    // Widest workgroup grid of the per-point stages, wrapping onto further rows past it. Every
+    // device supports 65535; fit() raises it to the device's maxComputeWorkGroupCount[0].
+    uint max_groups_x = 65535;
+
+    // `windows_per_group` 0 means one group of plain bases covering every window
+    explicit MsmPlan(uint points = 0, uint windows_per_group = 0, uint batch = 1,
+                     bool shared_bases = true) {
+        params = {points};
+        params.window_bits = msm_window_bits(points);
+        params.num_windows = msm_num_windows(params.window_bits);
+        params.segments = msm_segments(points, batch);
+        params.windows_per_group = windows_per_group ? windows_per_group : params.num_windows;
+        params.batch = batch;
+        params.shared_bases = shared_bases ? 1 : 0;
+        update();
+    }
+
+    // The plan for running on `vk`, see fit()
+    MsmPlan(const VulkanCompute& vk, uint points, uint windows_per_group = 0, uint batch = 1,
+            bool shared_bases = true)
+        : MsmPlan(points, windows_per_group, batch, shared_bases) {
+        fit(vk);
+    }
+
+    // Size the dispatches for `vk`, and exit when a buffer or dispatch of the plan exceeds its
+    // limits rather than bind an out-of-range buffer. Call again after changing `params`.
+    void fit(const VulkanCompute& vk) {
+        max_groups_x = vk.limits.maxComputeWorkGroupCount[0];
+        uint64_t range = vk.limits.maxStorageBufferRange;
+        std::vector<std::pair<const char*, size_t>> buffers = {
+            {"points", points_size()},
+            {"scalars", scalars_size()},
+            {"bucket lists", bucket_lists_size()},
+            {"buckets", buckets_size()},
+            {"window sums", window_sums_size()},
+        };
+        for (const auto& buffer : buffers) {
+            if (buffer.second <= range) continue;
+            std::cerr << "MSM of " << params.batch << "x" << params.points << " points needs "
+                      << buffer.second << " bytes of " << buffer.first
+                      << ", beyond maxStorageBufferRange (" << range
+                      << "); stream it in smaller chunks (--msm-stream, --msm-chunk)" << std::endl;
+            exit(1);
+        }
+        uint64_t lists = (uint64_t)params.batch * params.num_windows;
+        if (lists > vk.limits.maxComputeWorkGroupCount[2]) {
+            std::cerr << "MSM batch of " << params.batch << " needs " << lists
+                      << " workgroups in z, beyond maxComputeWorkGroupCount" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Refresh the per-stage params and scratch sizes after changing `params`
+    void update() {
+        for (uint i = 0; i < MSM_STAGES; ++i) {
+            stage_params[i] = params;
+            stage_params[i].stage = i;
+        }
+        scratch_sizes = {bucket_lists_size(), buckets_size(), window_sums_size()};
+    }
+
+    uint num_buckets() const { return msm_num_buckets(params.window_bits); }
+    uint num_groups() const {
+        return (params.num_windows + params.windows_per_group - 1) / params.windows_per_group;
+    }
+
+    // Point tables read from binding 0: one per group of each MSM unless the bases are shared
+    size_t num_tables() const {
+        return (size_t)(params.shared_bases ? 1 : params.batch) * num_groups();
+    }
+    size_t points_size() const {
+        return num_tables() * params.points * G1_SOA_WORDS * sizeof(uint32_t);
+    }
+    size_t scalars_size() const {
+        return (size_t)params.batch * params.points * sizeof(blst_scalar);
+    }
+
+    size_t buckets_size() const {
+        return (size_t)params.batch * params.num_windows * params.segments * num_buckets() *
+               sizeof(blst_p1);
+    }
+    size_t window_sums_size() const {
+        return (size_t)params.batch * params.num_windows * sizeof(blst_p1);
+    }
+
+    // Bucket offsets of every (MSM, window), then room for one entry per point of each
+    size_t bucket_lists_size() const {
+        size_t lists = (size_t)params.batch * params.num_windows;
+        return lists * (num_buckets() + params.points) * sizeof(uint32_t);
+    }
+
+    // Workgroups of 64 covering `invocations`, as rows of at most max_groups_x (see
+    // msm_sort_invocation)
+    void grid(uint64_t invocations, uint* groups_x, uint* groups_y) const {
+        uint64_t groups = std::max<uint64_t>(1, (invocations + 63) / 64);
+        *groups_x = (uint)std::min<uint64_t>(groups, max_groups_x);
+        *groups_y = (uint)((groups + *groups_x - 1) / *groups_x);
+    }
+
+    // Decomposition of the scalars into signed digits and the counting sort by bucket. The
+    // per-offset and per-point stages run on 2D grids, the latter with one z per (MSM, window).
+    // These stages point into this plan, which must outlive their submission.
+    std::vector<VulkanStage> sort_stages() const {
+        uint offset_x, offset_y, point_x, point_y;
+        grid((uint64_t)params.batch * params.num_windows * num_buckets(), &offset_x, &offset_y);
+        grid(params.points, &point_x, &point_y);
+        uint lists = params.batch * params.num_windows;
+        return {
+            {&stage_params[MSM_STAGE_CLEAR], sizeof(MsmParams), offset_x, offset_y, 1},
+            {&stage_params[MSM_STAGE_COUNT], sizeof(MsmParams), point_x, point_y, lists},
+            {&stage_params[MSM_STAGE_PREFIX], sizeof(MsmParams), (params.num_windows + 63) / 64,
+             params.batch, 1},
+            {&stage_params[MSM_STAGE_SCATTER], sizeof(MsmParams), point_x, point_y, lists},
+        };
+    }
+
+    // The sort stages followed by the Pippenger stages
+    std::vector<VulkanStage> stages() const {
+        uint bucket_groups = (num_buckets() + 63) / 64;
+        std::vector<VulkanStage> all = sort_stages();
+        std::vector<VulkanStage> pippenger = {
+            {&stage_params[MSM_STAGE_ACCUMULATE], sizeof(MsmParams), bucket_groups,
+             params.num_windows, params.batch * params.segments},
+            {&stage_params[MSM_STAGE_MERGE], sizeof(MsmParams), bucket_groups, params.num_windows,
+             params.batch},
+            {&stage_params[MSM_STAGE_REDUCE], sizeof(MsmParams), params.num_windows, params.batch,
+             1, MSM_REDUCE_PIPELINE},
+            {&stage_params[MSM_STAGE_COMBINE], sizeof(MsmParams), (params.batch + 63) / 64, 1, 1},
+        };
+        all.insert(all.end(), pippenger.begin(), pippenger.end());
+        return all;
+    }
+};
+
+// The REDUCE stage of msm.comp as built for `vk`: reducing windows with subgroup shuffles where
+// compute shaders have them, otherwise through shared memory
+inline const char* msm_reduce_shader(const VulkanCompute& vk) {
+    bool shuffle =
+        vk.hasSubgroupOperations(VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_SHUFFLE_BIT);
+    return shuffle ? MSM_REDUCE_SUBGROUP_SHADER : MSM_REDUCE_SHADER;
+}
+
+inline KernelSpec msm_kernel_spec(const VulkanCompute& vk) {
+    return {MSM_SHADER, MSM_BINDINGS, sizeof(MsmParams), {}, {msm_reduce_shader(vk)}};
+}
+
+// An MSM kernel outside any KernelCache, for callers binding resident buffers to it
+inline void init_msm_kernel(ComputeKernel& kernel, VulkanCompute& vk) {
+    KernelSpec spec = msm_kernel_spec(vk);
+    kernel.init(vk, spec.shaderPath, spec.numBindings, spec.pushConstantSize, spec.specialization,
+                spec.stageShaders);
+}
+
+const KernelSpec MSM_SORT_KERNEL = {MSM_SORT_SHADER, MSM_SORT_BINDINGS, sizeof(MsmParams), {}};
+
+inline ComputeKernel& msm_kernel(KernelCache& kernels) {
+    return kernels.get(msm_kernel_spec(*kernels.vk));
+}
+
+// Writes the point tables of `plan`, given in blst's layout as [table][point], to `soa` in the
+// device layout: plan.points_size() bytes
+inline void msm_write_device_points(const MsmPlan& plan, const blst_p1_affine* points,
+                                    uint32_t* soa) {
+    g1_tables_to_soa(points, plan.params.points, plan.num_tables(), soa);
+}
+
+inline AlignedVector<uint32_t> msm_device_points(const MsmPlan& plan,
+                                                 const blst_p1_affine* points) {
+    AlignedVector<uint32_t> soa(plan.points_size() / sizeof(uint32_t));
+    msm_write_device_points(plan, points, soa.data());
+    return soa;
+}
+
+// Input writer converting the points of `plan` straight into the upload buffer, so submit()
+// neither keeps a converted host copy nor leaves the conversion out of its upload time. `plan`
+// and `points` need only outlive the submit() call.
+inline InputWriter msm_points_writer(const MsmPlan& plan, const blst_p1_affine* points) {
+    return [&plan, points](void* dst, size_t) {
+        msm_write_device_points(plan, points, static_cast<uint32_t*>(dst));
+    };
+}
+
+// Queue sum(scalars[m * n + i] * points[i]) for each MSM m < plan.params.batch, over n =
+// plan.params.points points; without shared bases MSM m reads points[m * n + i]. `results`
+// receives one Jacobian point per MSM in blst's limb layout once the job completes. The points
+// are converted to the device layout as they are uploaded; DevicePoints keeps them converted.
+inline ComputeJob submit_msm(KernelCache& kernels, const MsmPlan& plan,
+                             const blst_p1_affine* points, const blst_scalar* scalars,
+                             blst_p1* results) {
+    std::vector<void*> inputs = {nullptr, (void*)scalars};
+    std::vector<size_t> input_sizes = {plan.points_size(), plan.scalars_size()};
+    return msm_kernel(kernels).submit(plan.stages(), inputs, input_sizes, plan.scratch_sizes,
+                                      results, plan.params.batch * sizeof(blst_p1),
+                                      {msm_points_writer(plan, points)});
+}
+
+// Split one MSM by point range into a shard per device of `group`, run the shards concurrently
+// and add their partial sums into `result`. Shards are equal, so the slowest device sets the pace.
+inline void sharded_msm(DeviceGroup& group, const blst_p1_affine* points,
+                        const blst_scalar* scalars, uint n, blst_p1* result) {
+    size_t shards = group.devices.size();
+    std::vector<MsmPlan> plans(shards);
+    std::vector<blst_p1> partial(shards);
+    std::vector<ComputeJob> jobs(shards);
+    for (size_t d = 0; d < shards; ++d) {
+        uint begin = (uint)(n * d / shards);
+        uint end = (uint)(n * (d + 1) / shards);
+        plans[d] = MsmPlan(*group.kernels[d].vk, end - begin);
+        memset(&partial[d], 0, sizeof(blst_p1));
+        if (end > begin) {
+            jobs[d] = submit_msm(group.kernels[d], plans[d], points + begin, scalars + begin,
+                                 &partial[d]);
+        }
+    }
+
+    memset(result, 0, sizeof(blst_p1));
+    for (size_t d = 0; d < shards; ++d) {
+        if (plans[d].params.points > 0) jobs[d].wait();
+        blst_p1_add_or_double(result, result, &partial[d]);
+    }
+}
+
+inline ComputeKernel& msm_sort_kernel(KernelCache& kernels) {
+    return kernels.get(MSM_SORT_KERNEL);
+}
+
+// Queue only the sort stages of `plan`. `bucket_lists` receives plan.bucket_lists_size() bytes
+// laid out as described in msm_sort.glsl.
+inline ComputeJob submit_msm_sort(KernelCache& kernels, const MsmPlan& plan,
+                                  const blst_scalar* scalars, uint32_t* bucket_lists) {
+    std::vector<void*> inputs = {(void*)scalars};
+    std::vector<size_t> input_sizes = {plan.scalars_size()};
+    return msm_sort_kernel(kernels).submit(plan.sort_stages(), inputs, input_sizes, {},
+                                           bucket_lists, plan.bucket_lists_size());
+}
+
+#endif  // GPU_MSM_H
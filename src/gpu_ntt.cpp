@@ -0,0 +1,81 @@
+#include "gpu_ntt.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+std::vector<blst_fr> ntt_device_table(const NttDomain& domain) {
+    uint n = domain.n;
+    std::vector<blst_fr> table(ntt_table_size(n));
+    std::copy(domain.twiddles.begin(), domain.twiddles.end(),
+              table.begin() + ntt_twiddle_index(n, 0, 0));
+    std::copy(domain.inverse_twiddles.begin(), domain.inverse_twiddles.end(),
+              table.begin() + ntt_twiddle_index(n, 0, 1));
+    blst_fr power = domain.shift;
+    blst_fr inverse_power = domain.shift_inv;
+    for (uint i = 0; i < NTT_MAX_LOG_N; ++i) {
+        table[ntt_shift_power_index(n, i, 0)] = power;
+        table[ntt_shift_power_index(n, i, 1)] = inverse_power;
+        blst_fr_sqr(&power, &power);
+        blst_fr_sqr(&inverse_power, &inverse_power);
+    }
+    table[ntt_inv_n_index(n)] = domain.n_inv;
+    return table;
+}
+
+uint gpu_ntt_max_log_n(const VulkanCompute& vk) {
+    // The table holds more values than the transform itself
+    uint log_n = NTT_MAX_SIZE_LOG_N;
+    while (log_n > 1 && (uint64_t)ntt_table_size(1u << log_n) * sizeof(blst_fr) >
+                            vk.limits.maxStorageBufferRange) {
+        --log_n;
+    }
+    return log_n;
+}
+
+void GpuNtt::init(VulkanCompute& vk_ref, const NttDomain& domain) {
+    vk = &vk_ref;
+    log_n = domain.log_n;
+    if (log_n > gpu_ntt_max_log_n(*vk)) {
+        std::cerr << "NTT of 2^" << log_n << " values exceeds maxStorageBufferRange" << std::endl;
+        exit(1);
+    }
+    std::vector<blst_fr> table = ntt_device_table(domain);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VkDeviceSize table_size = table.size() * sizeof(blst_fr);
+    table_buffer = vk->createStorageBuffer(table_size);
+    vk->upload(table_buffer, table.data(), table_size);
+    vk->staging.flush();
+    auto end = std::chrono::high_resolution_clock::now();
+    upload_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    kernel.init(*vk, NTT_SHADER, NTT_BINDINGS, sizeof(NttParams));
+    kernel.bindResident(1, table_buffer);
+}
+
+ComputeJob GpuNtt::submit(const blst_fr* values, blst_fr* result, bool inverse, bool coset) {
+    size_t n = size_t(1) << log_n;
+    size_t values_size = n * sizeof(blst_fr);
+
+    // One invocation per butterfly, over a 2D grid past the device's workgroup count limit.
+    // Push constants are recorded at submit, so the params need not outlive it.
+    uint groups = (uint)((n / 2 + 63) / 64);
+    uint groups_x = std::min(groups, vk->limits.maxComputeWorkGroupCount[0]);
+    uint groups_y = (groups + groups_x - 1) / groups_x;
+    std::vector<NttParams> params(log_n);
+    std::vector<VulkanStage> stages(log_n);
+    for (uint s = 0; s < log_n; ++s) {
+        params[s] = {log_n, s, inverse ? 1u : 0u, coset ? 1u : 0u};
+        stages[s] = {&params[s], sizeof(NttParams), groups_x, groups_y, 1};
+    }
+
+    std::vector<void*> inputs = {(void*)values, nullptr};
+    std::vector<size_t> input_sizes = {values_size, 0};
+    return kernel.submit(stages, inputs, input_sizes, {values_size}, result, values_size);
+}
+
+void GpuNtt::destroy() {
+    kernel.destroy();
+    vk->destroyBuffer(table_buffer);
+}
@@ -0,0 +1,41 @@
+#ifndef GPU_NTT_H
+#define GPU_NTT_H
+
+#include <vector>
+
+#include "blst.h"
+#include "common.h"
+#include "cpu_ntt.h"
+#include "vulkan_helper.h"
+
+#define NTT_SHADER "build/ntt.spv"
+
+// ntt.comp bindings: values, tables, scratch, result
+const uint32_t NTT_BINDINGS = 4;
+
+const KernelSpec NTT_KERNEL = {NTT_SHADER, NTT_BINDINGS, sizeof(NttParams), {}};
+
+// Largest log_n whose transform fits the storage buffers of `vk`, at most NTT_MAX_SIZE_LOG_N
+uint gpu_ntt_max_log_n(const VulkanCompute& vk);
+
+// The table ntt.comp reads for `domain`, laid out as ntt_table_size describes
+std::vector<blst_fr> ntt_device_table(const NttDomain& domain);
+
+// Transforms of one size on the device. init() uploads the domain's table once and keeps it
+// resident; each submit() uploads only the values.
+struct GpuNtt {
+    VulkanCompute* vk = nullptr;
+    ComputeKernel kernel;
+    GpuBuffer table_buffer;
+    uint log_n = 0;
+    double upload_ms = 0.0;  // copying the table to the device
+
+    void init(VulkanCompute& vk_ref, const NttDomain& domain);
+
+    // `result` receives the n transformed values once the job completes; `values` is not changed
+    ComputeJob submit(const blst_fr* values, blst_fr* result, bool inverse, bool coset);
+
+    void destroy();
+};
+
+#endif  // GPU_NTT_H
@@ -0,0 +1,72 @@
+#include "hybrid_msm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "cpu_msm.h"
+#include "gpu_msm.h"
+
+// Weight of the newest measurement in the smoothed throughputs
+const double THROUGHPUT_SMOOTHING = 0.5;
+
+// Never starve a device completely, so its throughput keeps being measured
+const double MIN_FRACTION = 0.02;
+
+void HybridMsm::init(KernelCache& kernel_cache, double initial_cpu_fraction) {
+    kernels = &kernel_cache;
+    cpu_fraction = initial_cpu_fraction;
+}
+
+static double smooth(double previous, double measured) {
+    if (previous == 0.0) return measured;
+    return THROUGHPUT_SMOOTHING * measured + (1.0 - THROUGHPUT_SMOOTHING) * previous;
+}
+
+void HybridMsm::run(const blst_p1_affine* points, const blst_scalar* scalars, uint n,
+                    blst_p1* result) {
+    auto start = std::chrono::high_resolution_clock::now();
+    uint cpu_points = std::min(n, (uint)(n * cpu_fraction + 0.5));
+    uint gpu_points = n - cpu_points;
+
+    // The GPU takes the tail of the range so its job is queued before the CPU starts
+    blst_p1 gpu_sum;
+    memset(&gpu_sum, 0, sizeof(gpu_sum));
+    MsmPlan plan(*kernels->vk, gpu_points);
+    ComputeJob job;
+    if (gpu_points > 0) {
+        job = submit_msm(*kernels, plan, points + cpu_points, scalars + cpu_points, &gpu_sum);
+    }
+
+    auto cpu_start = std::chrono::high_resolution_clock::now();
+    blst_p1 cpu_sum;
+    cpu_msm_parallel(points, scalars, cpu_points, &cpu_sum);
+    auto cpu_end = std::chrono::high_resolution_clock::now();
+
+    double gpu_ms = 0.0;
+    if (gpu_points > 0) {
+        job.wait();
+        const DispatchProfile& profile = job.profile();
+        double device_ms = profile.gpuUploadMs + profile.gpuComputeMs + profile.gpuReadbackMs;
+        gpu_ms = profile.hostUploadMs + (device_ms > 0.0 ? device_ms : profile.hostWaitMs);
+    }
+    blst_p1_add_or_double(result, &cpu_sum, &gpu_sum);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    last.cpu_points = cpu_points;
+    last.gpu_points = gpu_points;
+    last.cpu_ms = std::chrono::duration<double, std::milli>(cpu_end - cpu_start).count();
+    last.gpu_ms = gpu_ms;
+    last.total_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    if (cpu_points > 0 && last.cpu_ms > 0.0) {
+        cpu_points_per_ms = smooth(cpu_points_per_ms, cpu_points / last.cpu_ms);
+    }
+    if (gpu_points > 0 && gpu_ms > 0.0) {
+        gpu_points_per_ms = smooth(gpu_points_per_ms, gpu_points / gpu_ms);
+    }
+    if (cpu_points_per_ms > 0.0 && gpu_points_per_ms > 0.0) {
+        cpu_fraction = cpu_points_per_ms / (cpu_points_per_ms + gpu_points_per_ms);
+        cpu_fraction = std::max(MIN_FRACTION, std::min(1.0 - MIN_FRACTION, cpu_fraction));
+    }
+}
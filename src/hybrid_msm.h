@@ -0,0 +1,33 @@
+#ifndef HYBRID_MSM_H
+#define HYBRID_MSM_H
+
+#include "blst.h"
+#include "common.h"
+#include "vulkan_helper.h"
+
+// Measurements of one hybrid MSM
+struct HybridMsmRun {
+    uint cpu_points;
+    uint gpu_points;
+    double cpu_ms;    // blst over the CPU's point range, on all cores
+    double gpu_ms;    // device upload + compute + readback, or submit to fence without timestamps
+    double total_ms;  // wall time of the whole call, including the final addition
+};
+
+// Splits one MSM by point range between cpu_msm_parallel and msm.comp on the GPU, which run
+// concurrently, then adds the two partial sums. The CPU's share follows the ratio of the two
+// devices' measured throughputs, smoothed over earlier calls, so the split converges on the one
+// where both finish together.
+struct HybridMsm {
+    KernelCache* kernels = nullptr;
+    double cpu_fraction = 0.5;       // share of the points given to the CPU on the next call
+    double cpu_points_per_ms = 0.0;  // smoothed throughputs, 0 until first measured
+    double gpu_points_per_ms = 0.0;
+    HybridMsmRun last = {};
+
+    void init(KernelCache& kernel_cache, double initial_cpu_fraction = 0.5);
+
+    void run(const blst_p1_affine* points, const blst_scalar* scalars, uint n, blst_p1* result);
+};
+
+#endif  // HYBRID_MSM_H
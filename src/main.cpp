@@ -1,26 +1,41 @@
+#include <omp.h>
+
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 #include "blst.h"
 #include "common.h"
 #include "cpu_matmul.h"
 #include "cpu_msm.h"
+#include "cpu_ntt.h"
+#include "device_points.h"
+#include "field_check.h"
+#include "fixed_base_msm.h"
+#include "gpu_msm.h"
+#include "gpu_ntt.h"
+#include "hybrid_msm.h"
+#include "report.h"
+#include "streaming_msm.h"
 #include "vulkan_helper.h"
 
-std::vector<uint> load_spirv(const char* filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) throw std::runtime_error("failed to open shader file");
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<uint> buffer(fileSize / 4);
-
-    file.seekg(0);
-    file.read((char*)buffer.data(), fileSize);
-    file.close();
-    return buffer;
-}
+#define MATMUL_SHADER "build/vulkan_matmul.spv"
+#define MATMUL_TILED_SHADER "build/vulkan_matmul_tiled.spv"
+#define MATMUL_F16_SHADER "build/vulkan_matmul_f16.spv"
+#define MATMUL_I8_SHADER "build/vulkan_matmul_i8.spv"
+#define MATMUL_I8_DOT_SHADER "build/vulkan_matmul_i8_dot.spv"
+#define MATMUL_COOPMAT_SHADER "build/vulkan_matmul_coopmat.spv"
+#define MATMUL_COOPMAT_NV_SHADER "build/vulkan_matmul_coopmat_nv.spv"
+#define MATMUL_SPLITK_SHADER "build/vulkan_matmul_splitk.spv"
+#define MATMUL_SPLITK_SUBGROUP_SHADER "build/vulkan_matmul_splitk_subgroup.spv"
+const uint32_t MATMUL_SPLITK_COLUMNS = 4;  // outputs of C per workgroup, SPLITK_COLUMNS
+const uint32_t MATMUL_BINDINGS = 3;  // A, B, C
 
 void show_vk_info(VulkanCompute vk) {
     VkPhysicalDeviceProperties props;
@@ -68,254 +83,1640 @@ void show_vk_info(VulkanCompute vk) {
     std::cout << "--------------------------\n" << std::endl;
 }
 
-double run_vulkan(VulkanCompute& vk, const char* shader_path, void* params_ptr, size_t params_size,
-                  const std::vector<void*>& inputs, const std::vector<size_t>& input_sizes,
-                  void* output, size_t output_size, uint32_t gx, uint32_t gy, uint32_t gz) {
-    std::vector<VkBuffer> buffers(inputs.size() + 1);
-    std::vector<VkDeviceMemory> memories(inputs.size() + 1);
-
-    for (size_t i = 0; i < inputs.size(); ++i) {
-        buffers[i] =
-            vk.createBuffer(input_sizes[i], VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &memories[i]);
-        void* data;
-        vkMapMemory(vk.device, memories[i], 0, input_sizes[i], 0, &data);
-        memcpy(data, inputs[i], input_sizes[i]);
-        vkUnmapMemory(vk.device, memories[i]);
-    }
-
-    buffers.back() =
-        vk.createBuffer(output_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &memories.back());
-
-    auto spirv = load_spirv(shader_path);
-    VkShaderModuleCreateInfo createInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-    createInfo.codeSize = spirv.size() * 4;
-    createInfo.pCode = spirv.data();
-    VkShaderModule shaderModule;
-    VK_CHECK(vkCreateShaderModule(vk.device, &createInfo, nullptr, &shaderModule));
-
-    uint32_t num_bindings = inputs.size() + 1;
-    std::vector<VkDescriptorSetLayoutBinding> bindings(num_bindings);
-    for (uint32_t i = 0; i < num_bindings; ++i) {
-        bindings[i].binding = i;
-        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        bindings[i].descriptorCount = 1;
-        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    }
-
-    VkDescriptorSetLayoutCreateInfo layoutInfo = {
-        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-    layoutInfo.bindingCount = num_bindings;
-    layoutInfo.pBindings = bindings.data();
-    VkDescriptorSetLayout descriptorSetLayout;
-    VK_CHECK(vkCreateDescriptorSetLayout(vk.device, &layoutInfo, nullptr, &descriptorSetLayout));
-
-    VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, (uint32_t)params_size};
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-    VkPipelineLayout pipelineLayout;
-    VK_CHECK(vkCreatePipelineLayout(vk.device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
-
-    VkComputePipelineCreateInfo pipelineInfo = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
-    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    pipelineInfo.stage.module = shaderModule;
-    pipelineInfo.stage.pName = "main";
-    pipelineInfo.layout = pipelineLayout;
-    VkPipeline pipeline;
-    VK_CHECK(
-        vkCreateComputePipelines(vk.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
-
-    VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, num_bindings};
-    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    poolInfo.maxSets = 1;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    VkDescriptorPool descriptorPool;
-    VK_CHECK(vkCreateDescriptorPool(vk.device, &poolInfo, nullptr, &descriptorPool));
-
-    VkDescriptorSetAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &descriptorSetLayout;
-    VkDescriptorSet descriptorSet;
-    VK_CHECK(vkAllocateDescriptorSets(vk.device, &allocInfo, &descriptorSet));
-
-    std::vector<VkDescriptorBufferInfo> bufferInfos(num_bindings);
-    std::vector<VkWriteDescriptorSet> writes(num_bindings);
-    for (uint32_t i = 0; i < num_bindings; ++i) {
-        bufferInfos[i] = {buffers[i], 0, VK_WHOLE_SIZE};
-        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writes[i].dstSet = descriptorSet;
-        writes[i].dstBinding = i;
-        writes[i].descriptorCount = 1;
-        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        writes[i].pBufferInfo = &bufferInfos[i];
-    }
-    vkUpdateDescriptorSets(vk.device, num_bindings, writes.data(), 0, nullptr);
-
-    VkCommandPoolCreateInfo cmdPoolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
-    cmdPoolInfo.queueFamilyIndex = vk.queueFamilyIndex;
-    VkCommandPool commandPool;
-    VK_CHECK(vkCreateCommandPool(vk.device, &cmdPoolInfo, nullptr, &commandPool));
-
-    VkCommandBufferAllocateInfo cmdBufAllocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
-    cmdBufAllocInfo.commandPool = commandPool;
-    cmdBufAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdBufAllocInfo.commandBufferCount = 1;
-    VkCommandBuffer commandBuffer;
-    VK_CHECK(vkAllocateCommandBuffers(vk.device, &cmdBufAllocInfo, &commandBuffer));
-
-    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
-                            &descriptorSet, 0, nullptr);
-    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
-                       (uint32_t)params_size, params_ptr);
-    vkCmdDispatch(commandBuffer, gx, gy, gz);
-    vkEndCommandBuffer(commandBuffer);
-
-    auto v_start = std::chrono::high_resolution_clock::now();
-    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-    VK_CHECK(vkQueueSubmit(vk.queue, 1, &submitInfo, VK_NULL_HANDLE));
-    VK_CHECK(vkQueueWaitIdle(vk.queue));
-    auto v_end = std::chrono::high_resolution_clock::now();
-
-    void* out_data;
-    vkMapMemory(vk.device, memories.back(), 0, output_size, 0, &out_data);
-    memcpy(output, out_data, output_size);
-    vkUnmapMemory(vk.device, memories.back());
-
-    // Cleanup
-    vkDestroyCommandPool(vk.device, commandPool, nullptr);
-    vkDestroyDescriptorPool(vk.device, descriptorPool, nullptr);
-    vkDestroyPipeline(vk.device, pipeline, nullptr);
-    vkDestroyPipelineLayout(vk.device, pipelineLayout, nullptr);
-    vkDestroyDescriptorSetLayout(vk.device, descriptorSetLayout, nullptr);
-    vkDestroyShaderModule(vk.device, shaderModule, nullptr);
-    for (auto b : buffers) vkDestroyBuffer(vk.device, b, nullptr);
-    for (auto m : memories) vkFreeMemory(vk.device, m, nullptr);
-
-    return std::chrono::duration<double, std::milli>(v_end - v_start).count();
-}
-
-void benchmark_matmul(VulkanCompute& vk) {
-    MatrixParams params = {BATCH, M, K, N};
-    size_t sizeA = (size_t)BATCH * M * K;
-    size_t sizeB = (size_t)BATCH * K * N;
-    size_t sizeC = (size_t)BATCH * M * N;
-
-    std::vector<float> h_A(sizeA), h_B(sizeB), h_C_cpu(sizeC, 0.0f), h_C_gpu(sizeC, 0.0f);
-    for (size_t i = 0; i < sizeA; ++i) h_A[i] = static_cast<float>(rand()) / RAND_MAX;
-    for (size_t i = 0; i < sizeB; ++i) h_B[i] = static_cast<float>(rand()) / RAND_MAX;
+// Bindings are inputs, then scratch buffers, then the output. The kernel and its buffers are
+// created on first use and reused by later calls with the same shader.
+ComputeKernel& get_kernel(KernelCache& kernels, const char* shader_path,
+                          const std::vector<VulkanStage>& stages, size_t num_bindings,
+                          const std::vector<uint32_t>& specialization = {}) {
+    uint32_t params_size = 0;
+    for (const auto& stage : stages) {
+        params_size = std::max(params_size, (uint32_t)stage.params_size);
+    }
+    return kernels.get(shader_path, num_bindings, params_size, specialization);
+}
+
+struct GpuTiming {
+    double cold_ms;        // first call: pipeline and buffer creation, upload, dispatch, readback
+    double warm_ms;        // later calls: upload, dispatch, readback
+    DispatchProfile warm;  // per-phase breakdown of the later calls
+};
 
-    std::cout << "\nStarting Matrix Multiplication Benchmark..." << std::endl;
+const int WARM_RUNS = 3;
+
+// Time one cold call of `run` followed by WARM_RUNS warm calls, averaging their phase profiles
+template <typename F>
+GpuTiming time_vulkan(F run) {
+    GpuTiming timing = {};
     auto start = std::chrono::high_resolution_clock::now();
-    cpu_matmul(h_A, h_B, h_C_cpu, params);
+    run();
+    auto end = std::chrono::high_resolution_clock::now();
+    timing.cold_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < WARM_RUNS; ++i) {
+        DispatchProfile profile = run();
+        timing.warm.hostUploadMs += profile.hostUploadMs / WARM_RUNS;
+        timing.warm.hostWaitMs += profile.hostWaitMs / WARM_RUNS;
+        timing.warm.hostReadbackMs += profile.hostReadbackMs / WARM_RUNS;
+        timing.warm.gpuUploadMs += profile.gpuUploadMs / WARM_RUNS;
+        timing.warm.gpuComputeMs += profile.gpuComputeMs / WARM_RUNS;
+        timing.warm.gpuReadbackMs += profile.gpuReadbackMs / WARM_RUNS;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    timing.warm_ms = std::chrono::duration<double, std::milli>(end - start).count() / WARM_RUNS;
+    return timing;
+}
+
+// Device compute time when timestamps are available, otherwise submit-to-fence wall time
+double gpu_compute_ms(const GpuTiming& timing) {
+    return timing.warm.gpuComputeMs > 0.0 ? timing.warm.gpuComputeMs : timing.warm.hostWaitMs;
+}
+
+void set_gpu_result(BenchmarkResult& result, const GpuTiming& timing, double streamed_ms,
+                    double setup_ms) {
+    result.gpu_cold_ms = timing.cold_ms;
+    result.gpu_warm_ms = timing.warm_ms;
+    result.gpu_streamed_ms = streamed_ms;
+    result.host = {setup_ms, timing.warm.hostUploadMs, timing.warm.hostWaitMs,
+                   timing.warm.hostReadbackMs};
+    result.device = {0.0, timing.warm.gpuUploadMs, timing.warm.gpuComputeMs,
+                     timing.warm.gpuReadbackMs};
+}
+
+const int STREAM_JOBS = 8;
+
+// Submit STREAM_JOBS independent jobs back to back, keeping up to FRAMES_IN_FLIGHT in flight, and
+// return the mean wall time per job. `submit(i)` queues job i and returns its handle.
+template <typename F>
+double time_streamed(F submit) {
+    std::vector<ComputeJob> jobs;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < STREAM_JOBS; ++i) jobs.push_back(submit(i));
+    for (const auto& job : jobs) job.wait();
     auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> cpu_duration = end - start;
-    std::cout << "CPU MatMul Time: " << cpu_duration.count() << " ms" << std::endl;
+    return std::chrono::duration<double, std::milli>(end - start).count() / STREAM_JOBS;
+}
+
+void print_timing(const char* name, const GpuTiming& timing) {
+    std::cout << "Vulkan GPU " << name << " Cold Start: " << timing.cold_ms << " ms" << std::endl;
+    std::cout << "Vulkan GPU " << name << " Warm Call: " << timing.warm_ms << " ms" << std::endl;
+    std::cout << "Vulkan GPU " << name << " Time: " << timing.warm.hostWaitMs << " ms" << std::endl;
+    std::cout << "Vulkan GPU " << name << " Host Phases: upload " << timing.warm.hostUploadMs
+              << " ms, compute " << timing.warm.hostWaitMs << " ms, readback "
+              << timing.warm.hostReadbackMs << " ms" << std::endl;
+    if (timing.warm.gpuComputeMs > 0.0) {
+        std::cout << "Vulkan GPU " << name << " Device Phases: upload " << timing.warm.gpuUploadMs
+                  << " ms, compute " << timing.warm.gpuComputeMs << " ms, readback "
+                  << timing.warm.gpuReadbackMs << " ms" << std::endl;
+    }
+}
+
+void print_streamed(const char* name, double streamed_ms) {
+    std::cout << "Vulkan GPU " << name << " Streamed: " << streamed_ms << " ms/job ("
+              << STREAM_JOBS << " jobs, " << FRAMES_IN_FLIGHT << " in flight)" << std::endl;
+}
+
+// Tile configuration for vulkan_matmul_tiled.comp, passed as specialization constants 0..4
+struct MatmulTiling {
+    uint32_t wg_x, wg_y;  // workgroup shape, invocations along N and M
+    uint32_t tm, tn;      // register block per invocation
+    uint32_t bk;          // K depth of each shared-memory tile
+
+    uint32_t block_m() const { return wg_y * tm; }
+    uint32_t block_n() const { return wg_x * tn; }
+    size_t shared_bytes() const { return (size_t)(block_m() + block_n()) * bk * sizeof(float); }
+    std::vector<uint32_t> specialization() const { return {wg_x, wg_y, tm, tn, bk}; }
+};
+
+// The workgroup is a whole number of subgroups and at most 256 invocations. Its two shared tiles
+// stay within half of maxComputeSharedMemorySize so at least two workgroups fit per compute unit.
+MatmulTiling choose_matmul_tiling(const VulkanCompute& vk) {
+    const VkPhysicalDeviceLimits& limits = vk.limits;
+    uint32_t subgroup = vk.subgroupSize ? vk.subgroupSize : 32;
+    uint32_t invocations = std::min(256u, limits.maxComputeWorkGroupInvocations);
+    if (invocations >= subgroup) invocations -= invocations % subgroup;
+
+    MatmulTiling tiling = {16, 16, 4, 4, 16};
+    tiling.wg_x = std::min({16u, invocations, limits.maxComputeWorkGroupSize[0]});
+    tiling.wg_y = std::min(invocations / tiling.wg_x, limits.maxComputeWorkGroupSize[1]);
+
+    size_t shared_budget = limits.maxComputeSharedMemorySize / 2;
+    while (tiling.bk > 4 && tiling.shared_bytes() > shared_budget) tiling.bk /= 2;
+    while (tiling.tm > 1 && tiling.shared_bytes() > shared_budget) {
+        tiling.tm /= 2;
+        tiling.tn /= 2;
+    }
+    return tiling;
+}
+
+// The int8 MatMul shader: with the device's packed 8-bit dot product when it has one
+const char* matmul_i8_shader(const VulkanCompute& vk) {
+    return vk.integerDotProduct ? MATMUL_I8_DOT_SHADER : MATMUL_I8_SHADER;
+}
+
+bool has_subgroup_add(const VulkanCompute& vk) {
+    return vk.hasSubgroupOperations(VK_SUBGROUP_FEATURE_BASIC_BIT |
+                                    VK_SUBGROUP_FEATURE_ARITHMETIC_BIT);
+}
+
+// The split-K MatMul shader: adding partial sums with subgroupAdd where compute shaders have it
+const char* matmul_splitk_shader(const VulkanCompute& vk) {
+    return has_subgroup_add(vk) ? MATMUL_SPLITK_SUBGROUP_SHADER : MATMUL_SPLITK_SHADER;
+}
 
-    double gpu_matmul_time =
-        run_vulkan(vk, "build/vulkan_matmul.spv", &params, sizeof(params),
-                   {(void*)h_A.data(), (void*)h_B.data()},
-                   {h_A.size() * sizeof(float), h_B.size() * sizeof(float)}, h_C_gpu.data(),
-                   h_C_gpu.size() * sizeof(float), (M + 7) / 8, (N + 7) / 8, BATCH);
-    std::cout << "Vulkan GPU MatMul Time: " << gpu_matmul_time << " ms" << std::endl;
+// Cooperative-matrix MatMul configuration, passed as specialization constants 0..5: one subgroup
+// per workgroup, each computing rm x rn fragments of the device's fp16 shape
+struct CoopMatmulConfig {
+    uint32_t subgroup;
+    CooperativeMatrixShape shape;
+    uint32_t rm, rn;  // fragments per subgroup along M and N
+
+    uint32_t block_m() const { return rm * shape.m; }
+    uint32_t block_n() const { return rn * shape.n; }
+    std::vector<uint32_t> specialization() const {
+        return {subgroup, shape.m, shape.n, shape.k, rm, rn};
+    }
+};
+
+// 16x16x16 when the device offers it, as every vendor runs that shape at full rate, otherwise the
+// first shape it lists. Only valid when vk.cooperativeMatrixShapes is not empty.
+CoopMatmulConfig choose_coop_matmul(const VulkanCompute& vk) {
+    CoopMatmulConfig config = {vk.subgroupSize ? vk.subgroupSize : 32,
+                               vk.cooperativeMatrixShapes[0], 2, 2};
+    for (const CooperativeMatrixShape& shape : vk.cooperativeMatrixShapes) {
+        if (shape.m == 16 && shape.n == 16 && shape.k == 16) config.shape = shape;
+    }
+    return config;
+}
+
+const char* matmul_coopmat_shader(const VulkanCompute& vk) {
+    return vk.cooperativeMatrixNV ? MATMUL_COOPMAT_NV_SHADER : MATMUL_COOPMAT_SHADER;
+}
+
+// --matmul-backend: which kernels benchmark_matmul runs. "auto" runs every kernel the device
+// supports; "coopmat" falls back to the tiled fp16 kernel on devices without cooperative matrices.
+enum MatmulBackend { MATMUL_AUTO, MATMUL_NAIVE, MATMUL_TILED, MATMUL_COOPMAT };
+
+bool runs_naive(MatmulBackend backend) {
+    return backend == MATMUL_AUTO || backend == MATMUL_NAIVE;
+}
+
+bool runs_tiled(MatmulBackend backend) {
+    return backend == MATMUL_AUTO || backend == MATMUL_TILED;
+}
+
+bool runs_coopmat(const VulkanCompute& vk, MatmulBackend backend) {
+    bool selected = backend == MATMUL_AUTO || backend == MATMUL_COOPMAT;
+    return selected && !vk.cooperativeMatrixShapes.empty();
+}
+
+// The tiled fp16 kernel runs with the tiled backend and in place of a missing cooperative matrix
+bool runs_tiled_f16(const VulkanCompute& vk, MatmulBackend backend) {
+    return runs_tiled(backend) ||
+           (backend == MATMUL_COOPMAT && vk.cooperativeMatrixShapes.empty());
+}
+
+// Kernel variants the selected benchmarks use on `vk`: the MatMul benchmark's kernels for
+// `backend` (naive, tiled over fp32, fp16 and int8 as tuned for this device, split-K, cooperative
+// matrix), the tiled fp32 MatMul alone, the MSM kernel, the standalone MSM sort and the NTT
+std::vector<KernelSpec> startup_kernels(const VulkanCompute& vk, bool matmul, bool tiled_matmul,
+                                        bool msm, bool msm_sort, bool ntt = false,
+                                        MatmulBackend backend = MATMUL_AUTO) {
+    std::vector<KernelSpec> specs;
+    std::vector<uint32_t> tiling = choose_matmul_tiling(vk).specialization();
+    if (matmul && runs_naive(backend)) {
+        specs.push_back({MATMUL_SHADER, MATMUL_BINDINGS, sizeof(MatrixParams), {}});
+    }
+    if (matmul && runs_tiled_f16(vk, backend)) {
+        specs.push_back({MATMUL_F16_SHADER, MATMUL_BINDINGS, sizeof(MatrixParams), tiling});
+    }
+    if (matmul && runs_tiled(backend)) {
+        specs.push_back({matmul_i8_shader(vk), MATMUL_BINDINGS, sizeof(MatrixParams), tiling});
+        specs.push_back({matmul_splitk_shader(vk), MATMUL_BINDINGS, sizeof(MatrixParams), {}});
+    }
+    if (matmul && runs_coopmat(vk, backend)) {
+        specs.push_back({matmul_coopmat_shader(vk), MATMUL_BINDINGS, sizeof(MatrixParams),
+                         choose_coop_matmul(vk).specialization()});
+    }
+    if (tiled_matmul) {
+        specs.push_back({MATMUL_TILED_SHADER, MATMUL_BINDINGS, sizeof(MatrixParams), tiling});
+    }
+    if (msm) specs.push_back(msm_kernel_spec(vk));
+    if (msm_sort) specs.push_back(MSM_SORT_KERNEL);
+    if (ntt) specs.push_back(NTT_KERNEL);
+    return specs;
+}
+
+// Create `specs` up front, in parallel, so benchmarks never pay for pipeline creation. Their
+// setup time is still reported per kernel.
+void warm_up_kernels(KernelCache& kernels, const std::vector<KernelSpec>& specs,
+                     const std::string& label) {
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t created = kernels.warmUp(specs);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << label << " kernel warm-up: " << created << " pipelines in "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+              << std::endl;
+}
+
+// Time, stream and verify one GPU matmul kernel against the CPU result. In is the element type of
+// A and B as uploaded, Out that of C; integer results must match exactly, float ones within 1e-3.
+template <typename In, typename Out>
+BenchmarkResult benchmark_matmul_kernel(KernelCache& kernels, const char* name, const char* label,
+                                        const char* shader_path,
+                                        const std::vector<uint32_t>& specialization,
+                                        const std::vector<VulkanStage>& stages,
+                                        const MatrixParams& params, const std::vector<In>& h_A,
+                                        const std::vector<In>& h_B,
+                                        const std::vector<Out>& h_C_cpu, double cpu_ms) {
+    size_t sizeC = h_C_cpu.size();
+    std::vector<Out> h_C_gpu(sizeC, 0);
+    std::vector<void*> inputs = {(void*)h_A.data(), (void*)h_B.data()};
+    std::vector<size_t> input_sizes = {h_A.size() * sizeof(In), h_B.size() * sizeof(In)};
+    size_t output_size = sizeC * sizeof(Out);
+
+    ComputeKernel& kernel =
+        get_kernel(kernels, shader_path, stages, MATMUL_BINDINGS, specialization);
+    GpuTiming gpu_timing = time_vulkan([&]() {
+        return kernel.dispatch(stages, inputs, input_sizes, {}, h_C_gpu.data(), output_size);
+    });
+    print_timing(label, gpu_timing);
+
+    std::vector<std::vector<Out>> h_C_streamed(STREAM_JOBS, std::vector<Out>(sizeC));
+    double streamed_ms = time_streamed([&](int i) {
+        return kernel.submit(stages, inputs, input_sizes, {}, h_C_streamed[i].data(), output_size);
+    });
+    print_streamed(label, streamed_ms);
 
     // Verification
+    double tolerance = std::is_integral<Out>::value ? 0.0 : 1e-3;
     bool match = true;
     for (size_t i = 0; i < sizeC; ++i) {
-        if (std::abs(h_C_cpu[i] - h_C_gpu[i]) > 1e-3) {
+        if (std::abs((double)h_C_cpu[i] - (double)h_C_gpu[i]) > tolerance) {
             match = false;
-            std::cout << "MatMul Mismatch at " << i << ": CPU=" << h_C_cpu[i]
+            std::cout << label << " Mismatch at " << i << ": CPU=" << h_C_cpu[i]
                       << " GPU=" << h_C_gpu[i] << std::endl;
             break;
         }
     }
-    std::cout << "MatMul Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+    std::cout << label << " Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    double flops = 2.0 * params.batch * params.m * params.n * params.k;
+    BenchmarkResult result = {};
+    result.name = name;
+    result.shape = std::to_string(params.batch) + "x" + std::to_string(params.m) + "x" +
+                   std::to_string(params.k) + "x" + std::to_string(params.n);
+    result.throughput_unit = std::is_integral<Out>::value ? "GOP/s" : "GFLOP/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = flops / cpu_ms / 1e6;
+    set_gpu_result(result, gpu_timing, streamed_ms, kernel.setupMs);
+    result.gpu_throughput = flops / gpu_compute_ms(gpu_timing) / 1e6;
+    result.verified = match;
+    return result;
 }
 
-void benchmark_msm(VulkanCompute& vk) {
-    std::cout << "\nStarting Multi-Scalar Multiplication (MSM) Benchmark..." << std::endl;
-    MsmParams params_msm = {MSM_POINTS};
-    size_t sizePoints = MSM_POINTS * sizeof(blst_p1_affine) / sizeof(float);
-    size_t sizeScalars = MSM_POINTS * sizeof(blst_scalar) / sizeof(float);
-    size_t sizeResult = sizeof(blst_p1_affine) / sizeof(float);
-
-    std::vector<float> h_points(sizePoints), h_scalars(sizeScalars), h_res_cpu(sizeResult, 0.0f),
-        h_res_gpu(sizeResult, 0.0f);
-
-    // Generate valid test data using blst
-    blst_p1_affine* p_points = reinterpret_cast<blst_p1_affine*>(h_points.data());
-    blst_scalar* p_scalars = reinterpret_cast<blst_scalar*>(h_scalars.data());
-    for (uint i = 0; i < MSM_POINTS; ++i) {
+// Copy `batch` rows x cols matrices into the top-left corners of zeroed padded_rows x padded_cols
+// ones
+template <typename T>
+std::vector<T> pad_matrices(const std::vector<T>& src, uint batch, uint rows, uint cols,
+                            uint padded_rows, uint padded_cols) {
+    std::vector<T> padded((size_t)batch * padded_rows * padded_cols, T(0));
+    for (uint b = 0; b < batch; ++b) {
+        for (uint r = 0; r < rows; ++r) {
+            const T* row = src.data() + ((size_t)b * rows + r) * cols;
+            size_t offset = ((size_t)b * padded_rows + r) * padded_cols;
+            std::copy(row, row + cols, padded.begin() + offset);
+        }
+    }
+    return padded;
+}
+
+inline uint round_up(uint value, uint multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+std::vector<BenchmarkResult> benchmark_matmul(KernelCache& kernels, MatrixParams params,
+                                              MatmulBackend backend = MATMUL_AUTO) {
+    const VulkanCompute& vk = *kernels.vk;
+    size_t sizeA = (size_t)params.batch * params.m * params.k;
+    size_t sizeB = (size_t)params.batch * params.k * params.n;
+    size_t sizeC = (size_t)params.batch * params.m * params.n;
+
+    std::vector<float> h_A(sizeA), h_B(sizeB), h_C_cpu(sizeC, 0.0f);
+    for (size_t i = 0; i < sizeA; ++i) h_A[i] = static_cast<float>(rand()) / RAND_MAX;
+    for (size_t i = 0; i < sizeB; ++i) h_B[i] = static_cast<float>(rand()) / RAND_MAX;
+
+    std::cout << "\nStarting Matrix Multiplication Benchmark (" << params.batch << "x" << params.m
+              << "x" << params.k << "x" << params.n << ")..." << std::endl;
+    std::vector<BenchmarkResult> results;
+    bool fp32 = runs_naive(backend) || runs_tiled(backend);
+    double cpu_ms = 0.0;
+    if (fp32) {
+        auto start = std::chrono::high_resolution_clock::now();
+        cpu_matmul(h_A, h_B, h_C_cpu, params);
+        auto end = std::chrono::high_resolution_clock::now();
+        cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << "CPU MatMul Time (" << cpu_matmul_isa() << "): " << cpu_ms << " ms"
+                  << std::endl;
+    }
+
+    if (runs_naive(backend)) {
+        std::vector<VulkanStage> naive = {
+            {&params, sizeof(params), (params.m + 7) / 8, (params.n + 7) / 8, params.batch}};
+        results.push_back(benchmark_matmul_kernel(kernels, "matmul", "MatMul", MATMUL_SHADER, {},
+                                                  naive, params, h_A, h_B, h_C_cpu, cpu_ms));
+    }
+
+    MatmulTiling tiling = choose_matmul_tiling(vk);
+    std::vector<VulkanStage> tiled = {{&params, sizeof(params),
+                                       (params.n + tiling.block_n() - 1) / tiling.block_n(),
+                                       (params.m + tiling.block_m() - 1) / tiling.block_m(),
+                                       params.batch}};
+    if (runs_tiled(backend) || runs_tiled_f16(vk, backend)) {
+        std::cout << "Tiled MatMul: workgroup " << tiling.wg_x << "x" << tiling.wg_y << ", block "
+                  << tiling.block_m() << "x" << tiling.block_n() << "x" << tiling.bk << ", "
+                  << tiling.shared_bytes() << " bytes shared, subgroup " << vk.subgroupSize
+                  << std::endl;
+    }
+    if (runs_tiled(backend)) {
+        results.push_back(benchmark_matmul_kernel(kernels, "matmul_tiled", "Tiled MatMul",
+                                                  MATMUL_TILED_SHADER, tiling.specialization(),
+                                                  tiled, params, h_A, h_B, h_C_cpu, cpu_ms));
+
+        // K split over the invocations of a workgroup, the partial sums reduced in registers
+        // where the device has subgroup arithmetic
+        std::cout << "Split-K MatMul: partial sums reduced "
+                  << (has_subgroup_add(vk) ? "by subgroups" : "in shared memory") << std::endl;
+        std::vector<VulkanStage> splitk = {
+            {&params, sizeof(params),
+             (params.n + MATMUL_SPLITK_COLUMNS - 1) / MATMUL_SPLITK_COLUMNS, params.m,
+             params.batch}};
+        results.push_back(benchmark_matmul_kernel(kernels, "matmul_splitk", "Split-K MatMul",
+                                                  matmul_splitk_shader(vk), {}, splitk, params,
+                                                  h_A, h_B, h_C_cpu, cpu_ms));
+    }
+
+    if (backend == MATMUL_COOPMAT && !runs_coopmat(vk, backend)) {
+        std::cout << "Cooperative matrices unavailable on this device, using the tiled FP16 MatMul"
+                  << std::endl;
+    }
+    if (runs_tiled_f16(vk, backend) || runs_coopmat(vk, backend)) {
+        // fp16 storage with fp32 accumulation, over the same inputs rounded to fp16. The tiled
+        // shader reads pairs of halves as words, so the arrays are padded to an even length.
+        std::vector<uint16_t> h_A16((sizeA + 1) & ~size_t(1)), h_B16((sizeB + 1) & ~size_t(1));
+        float_to_half(h_A.data(), h_A16.data(), sizeA);
+        float_to_half(h_B.data(), h_B16.data(), sizeB);
+        std::vector<float> h_C16_cpu(sizeC);
+        auto start = std::chrono::high_resolution_clock::now();
+        cpu_matmul_f16(h_A16, h_B16, h_C16_cpu, params);
+        auto end = std::chrono::high_resolution_clock::now();
+        double cpu_f16_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << "\nCPU FP16 MatMul Time (" << cpu_matmul_isa() << "): " << cpu_f16_ms
+                  << " ms" << std::endl;
+        if (runs_tiled_f16(vk, backend)) {
+            results.push_back(benchmark_matmul_kernel(kernels, "matmul_f16", "FP16 MatMul",
+                                                      MATMUL_F16_SHADER, tiling.specialization(),
+                                                      tiled, params, h_A16, h_B16, h_C16_cpu,
+                                                      cpu_f16_ms));
+        }
+
+        if (runs_coopmat(vk, backend)) {
+            // Fragments cover whole tiles, so every dimension is padded with zeros to the
+            // subgroup's block. The zero rows and columns of C are checked along with the rest.
+            CoopMatmulConfig coop = choose_coop_matmul(vk);
+            MatrixParams padded = {params.batch, round_up(params.m, coop.block_m()),
+                                   round_up(params.k, coop.shape.k),
+                                   round_up(params.n, coop.block_n())};
+            std::cout << "Cooperative Matrix MatMul: " << (vk.cooperativeMatrixNV ? "NV" : "KHR")
+                      << " " << coop.shape.m << "x" << coop.shape.n << "x" << coop.shape.k
+                      << " fragments, block " << coop.block_m() << "x" << coop.block_n()
+                      << ", padded to " << padded.m << "x" << padded.k << "x" << padded.n
+                      << std::endl;
+            std::vector<uint16_t> h_Ap =
+                pad_matrices(h_A16, params.batch, params.m, params.k, padded.m, padded.k);
+            std::vector<uint16_t> h_Bp =
+                pad_matrices(h_B16, params.batch, params.k, params.n, padded.k, padded.n);
+            std::vector<float> h_Cp_cpu =
+                pad_matrices(h_C16_cpu, params.batch, params.m, params.n, padded.m, padded.n);
+            std::vector<VulkanStage> coop_stages = {{&padded, sizeof(padded),
+                                                     padded.n / coop.block_n(),
+                                                     padded.m / coop.block_m(), params.batch}};
+            results.push_back(benchmark_matmul_kernel(
+                kernels, "matmul_coopmat", "Cooperative Matrix MatMul", matmul_coopmat_shader(vk),
+                coop.specialization(), coop_stages, params, h_Ap, h_Bp, h_Cp_cpu, cpu_f16_ms));
+        }
+    }
+
+    if (runs_tiled(backend)) {
+        // int8 with int32 accumulation, four values per word
+        std::vector<int8_t> h_A8((sizeA + 3) & ~size_t(3)), h_B8((sizeB + 3) & ~size_t(3));
+        for (size_t i = 0; i < sizeA; ++i) h_A8[i] = (int8_t)(rand() % 256 - 128);
+        for (size_t i = 0; i < sizeB; ++i) h_B8[i] = (int8_t)(rand() % 256 - 128);
+        std::vector<int32_t> h_C8_cpu(sizeC);
+        auto start = std::chrono::high_resolution_clock::now();
+        cpu_matmul_i8(h_A8, h_B8, h_C8_cpu, params);
+        auto end = std::chrono::high_resolution_clock::now();
+        double cpu_i8_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << "\nCPU INT8 MatMul Time (AVX2): " << cpu_i8_ms << " ms" << std::endl;
+        std::cout << "INT8 MatMul: integer dot product "
+                  << (vk.integerDotProductAccelerated ? "accelerated"
+                      : vk.integerDotProduct          ? "emulated by the driver"
+                                                      : "unavailable, using shifts")
+                  << std::endl;
+        results.push_back(benchmark_matmul_kernel(kernels, "matmul_i8", "INT8 MatMul",
+                                                  matmul_i8_shader(vk), tiling.specialization(),
+                                                  tiled, params, h_A8, h_B8, h_C8_cpu,
+                                                  cpu_i8_ms));
+    }
+    return results;
+}
+
+struct MsmInputs {
+    PointVector points;
+    ScalarVector scalars;
+};
+
+// Generate valid test data using blst. Benchmarks over fewer points use a prefix.
+MsmInputs generate_msm_inputs(uint num_points) {
+    MsmInputs inputs;
+    inputs.points.resize(num_points);
+    inputs.scalars.resize(num_points);
+    for (uint i = 0; i < num_points; ++i) {
         blst_scalar sk;
         byte ikm[32];
         for (int j = 0; j < 32; ++j) ikm[j] = rand() & 0xFF;
         blst_keygen(&sk, ikm, 32);
-        p_scalars[i] = sk;
+        inputs.scalars[i] = sk;
 
         blst_p1 p;
         blst_sk_to_pk_in_g1(&p, &sk);
-        blst_p1_to_affine(&p_points[i], &p);
+        blst_p1_to_affine(&inputs.points[i], &p);
     }
+    return inputs;
+}
+
+// MSM over the first `num_points` points and scalars of `msm_inputs`
+BenchmarkResult benchmark_msm(KernelCache& kernels, const MsmInputs& msm_inputs, uint num_points) {
+    std::cout << "\nStarting Multi-Scalar Multiplication (MSM) Benchmark..." << std::endl;
+    const blst_p1_affine* points = msm_inputs.points.data();
+    const blst_scalar* scalars = msm_inputs.scalars.data();
 
-    std::cout << "MSM Points: " << MSM_POINTS << std::endl;
+    std::cout << "MSM Points: " << num_points << std::endl;
     auto start = std::chrono::high_resolution_clock::now();
-    cpu_msm(h_points, h_scalars, h_res_cpu, params_msm);
+    blst_p1_affine cpu_result;
+    cpu_msm(points, scalars, num_points, &cpu_result);
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double, std::milli> cpu_msm_duration = end - start;
-    std::cout << "CPU MSM Time: " << cpu_msm_duration.count() << " ms" << std::endl;
+    std::cout << "CPU MSM Time (" << omp_get_max_threads() << " threads, window bits "
+              << cpu_msm_window_bits(num_points, omp_get_max_threads())
+              << "): " << cpu_msm_duration.count() << " ms" << std::endl;
+
+    // The serial blst call is the reference for both the parallel CPU engine and the GPU
+    blst_p1 expected;
+    start = std::chrono::high_resolution_clock::now();
+    cpu_msm_blst(points, scalars, num_points, &expected);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "CPU MSM Time (blst, 1 thread): "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+              << std::endl;
+    blst_p1_affine expected_affine;
+    blst_p1_to_affine(&expected_affine, &expected);
+    bool cpu_match = memcmp(&expected_affine, &cpu_result, sizeof(blst_p1_affine)) == 0;
+    std::cout << "CPU MSM Verification: " << (cpu_match ? "PASSED" : "FAILED") << std::endl;
+
+    MsmPlan plan(*kernels.vk, num_points);
+    std::cout << "MSM Window Bits: " << plan.params.window_bits
+              << ", Windows: " << plan.params.num_windows
+              << ", Segments: " << plan.params.segments << std::endl;
+
+    blst_p1 gpu_jacobian;
+    GpuTiming gpu_timing = time_vulkan([&]() {
+        ComputeJob job = submit_msm(kernels, plan, points, scalars, &gpu_jacobian);
+        job.wait();
+        return job.profile();
+    });
+    print_timing("MSM", gpu_timing);
+
+    ComputeKernel& kernel = msm_kernel(kernels);
+    std::vector<blst_p1> h_res_streamed(STREAM_JOBS);
+    double streamed_ms = time_streamed([&](int i) {
+        return submit_msm(kernels, plan, points, scalars, &h_res_streamed[i]);
+    });
+    print_streamed("MSM", streamed_ms);
+
+    // Verification: the GPU returns a Jacobian point in blst's limb layout
+    blst_p1_affine gpu_affine;
+    blst_p1_to_affine(&gpu_affine, &gpu_jacobian);
+    bool match = memcmp(&gpu_affine, &expected_affine, sizeof(blst_p1_affine)) == 0;
+    std::cout << "MSM Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "msm";
+    result.shape = std::to_string(num_points);
+    result.throughput_unit = "points/s";
+    result.cpu_ms = cpu_msm_duration.count();
+    result.cpu_throughput = num_points / result.cpu_ms * 1e3;
+    set_gpu_result(result, gpu_timing, streamed_ms, kernel.setupMs);
+    result.gpu_throughput = num_points / gpu_compute_ms(gpu_timing) * 1e3;
+    result.verified = match && cpu_match;
+    return result;
+}
+
+// The scalar decomposition and bucket sort of msm.comp on their own, against the same counting
+// sort on every CPU core. Entry order within a bucket is not deterministic on the GPU, so each
+// bucket's entries are compared as sorted sets.
+BenchmarkResult benchmark_msm_sort(KernelCache& kernels, const MsmInputs& msm_inputs,
+                                   uint num_points) {
+    std::cout << "\nStarting MSM Bucket Sort Benchmark..." << std::endl;
+    const blst_scalar* scalars = msm_inputs.scalars.data();
+    MsmPlan plan(*kernels.vk, num_points);
+    uint c = plan.params.window_bits;
+    uint num_windows = plan.params.num_windows;
+    uint num_buckets = plan.num_buckets();
+    size_t list_words = plan.bucket_lists_size() / sizeof(uint32_t);
+    std::cout << "MSM Sort Window Bits: " << c << ", Windows: " << num_windows
+              << ", Buckets: " << num_buckets << std::endl;
+
+    std::vector<uint32_t> cpu_lists(list_words);
+    auto start = std::chrono::high_resolution_clock::now();
+    cpu_msm_sort_buckets(scalars, num_points, c, cpu_lists.data());
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << "CPU Bucket Sort Time: " << cpu_ms << " ms" << std::endl;
+
+    std::vector<uint32_t> gpu_lists(list_words);
+    GpuTiming gpu_timing = time_vulkan([&]() {
+        ComputeJob job = submit_msm_sort(kernels, plan, scalars, gpu_lists.data());
+        job.wait();
+        return job.profile();
+    });
+    print_timing("Bucket Sort", gpu_timing);
+
+    bool match = std::equal(cpu_lists.begin(), cpu_lists.begin() + num_windows * num_buckets,
+                            gpu_lists.begin());
+    size_t entries = (size_t)num_windows * num_buckets;
+    for (uint w = 0; w < num_windows && match; ++w) {
+        const uint32_t* offsets = &cpu_lists[(size_t)w * num_buckets];
+        uint32_t* gpu_entries = &gpu_lists[entries + (size_t)w * num_points];
+        const uint32_t* cpu_entries = &cpu_lists[entries + (size_t)w * num_points];
+        for (uint b = 0; b < num_buckets && match; ++b) {
+            uint32_t begin = b == 0 ? 0 : offsets[b - 1];
+            std::sort(gpu_entries + begin, gpu_entries + offsets[b]);
+            match = std::equal(cpu_entries + begin, cpu_entries + offsets[b], gpu_entries + begin);
+        }
+    }
+    std::cout << "Bucket Sort Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "msm_sort";
+    result.shape = std::to_string(num_points);
+    result.throughput_unit = "points/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = num_points / cpu_ms * 1e3;
+    set_gpu_result(result, gpu_timing, 0.0, msm_sort_kernel(kernels).setupMs);
+    result.gpu_throughput = num_points / gpu_compute_ms(gpu_timing) * 1e3;
+    result.verified = match;
+    return result;
+}
+
+// Scalars of `batch` MSMs over `num_points` points: those of `msm_inputs` for the first, random
+// ones for the rest
+ScalarVector batch_scalars(const MsmInputs& msm_inputs, uint num_points, uint batch) {
+    ScalarVector scalars((size_t)batch * num_points);
+    memcpy(scalars.data(), msm_inputs.scalars.data(), num_points * sizeof(blst_scalar));
+    for (size_t i = num_points; i < scalars.size(); ++i) {
+        byte ikm[32];
+        for (int j = 0; j < 32; ++j) ikm[j] = rand() & 0xFF;
+        blst_keygen(&scalars[i], ikm, 32);
+    }
+    return scalars;
+}
+
+// `batch` MSMs over the shared bases of `msm_inputs`, each with its own scalars, evaluated once as
+// separate synchronous calls and once as a single batched submission
+BenchmarkResult benchmark_batched_msm(KernelCache& kernels, const MsmInputs& msm_inputs,
+                                      uint num_points, uint batch) {
+    std::cout << "\nStarting Batched MSM Benchmark..." << std::endl;
+    const blst_p1_affine* points = msm_inputs.points.data();
+    ScalarVector scalars = batch_scalars(msm_inputs, num_points, batch);
+    std::cout << "MSM Batch: " << batch << " x " << num_points << " points" << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<blst_p1> expected(batch);
+    for (uint m = 0; m < batch; ++m) {
+        cpu_msm_parallel(points, &scalars[(size_t)m * num_points], num_points, &expected[m]);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << "CPU Batched MSM Time: " << cpu_ms << " ms" << std::endl;
+
+    // One submission and wait per MSM
+    MsmPlan single(*kernels.vk, num_points);
+    std::vector<blst_p1> separate(batch);
+    auto run_separate = [&]() {
+        for (uint m = 0; m < batch; ++m) {
+            submit_msm(kernels, single, points, &scalars[(size_t)m * num_points], &separate[m])
+                .wait();
+        }
+    };
+    run_separate();
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < WARM_RUNS; ++i) run_separate();
+    end = std::chrono::high_resolution_clock::now();
+    double separate_ms = std::chrono::duration<double, std::milli>(end - start).count() / WARM_RUNS;
+    std::cout << "Vulkan Separate MSM Time: " << separate_ms << " ms" << std::endl;
+
+    MsmPlan plan(*kernels.vk, num_points, 0, batch);
+    std::vector<blst_p1> batched(batch);
+    GpuTiming gpu_timing = time_vulkan([&]() {
+        ComputeJob job = submit_msm(kernels, plan, points, scalars.data(), batched.data());
+        job.wait();
+        return job.profile();
+    });
+    print_timing("Batched MSM", gpu_timing);
+    std::cout << "Batched vs Separate Speedup: " << separate_ms / gpu_timing.warm_ms << "x"
+              << std::endl;
+
+    bool match = true;
+    for (uint m = 0; m < batch; ++m) {
+        match = match && blst_p1_is_equal(&batched[m], &expected[m]) &&
+                blst_p1_is_equal(&separate[m], &expected[m]);
+    }
+    std::cout << "Batched MSM Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "msm_batch";
+    result.shape = std::to_string(batch) + "x" + std::to_string(num_points);
+    result.throughput_unit = "points/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = (double)batch * num_points / cpu_ms * 1e3;
+    set_gpu_result(result, gpu_timing, 0.0, msm_kernel(kernels).setupMs);
+    result.gpu_throughput = (double)batch * num_points / gpu_compute_ms(gpu_timing) * 1e3;
+    result.verified = match;
+    return result;
+}
+
+// `batch` MSMs in one submission, each over its own bases: MSM m reads the points of
+// `msm_inputs` rotated by m * num_points / batch, so every MSM has a distinct table. Each result
+// is checked against blst on that MSM's bases.
+BenchmarkResult benchmark_batched_msm_distinct_bases(KernelCache& kernels,
+                                                     const MsmInputs& msm_inputs, uint num_points,
+                                                     uint batch) {
+    std::cout << "\nStarting Batched MSM Benchmark (distinct bases)..." << std::endl;
+    ScalarVector scalars = batch_scalars(msm_inputs, num_points, batch);
+    PointVector points((size_t)batch * num_points);
+    for (uint m = 0; m < batch; ++m) {
+        size_t shift = (size_t)m * num_points / batch;
+        for (size_t i = 0; i < num_points; ++i) {
+            points[(size_t)m * num_points + i] = msm_inputs.points[(i + shift) % num_points];
+        }
+    }
+    std::cout << "MSM Batch: " << batch << " x " << num_points << " points, " << batch
+              << " point tables" << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<blst_p1> expected(batch);
+    for (uint m = 0; m < batch; ++m) {
+        size_t first = (size_t)m * num_points;
+        cpu_msm_blst(&points[first], &scalars[first], num_points, &expected[m]);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << "CPU Batched MSM Time (blst, 1 thread): " << cpu_ms << " ms" << std::endl;
+
+    MsmPlan plan(*kernels.vk, num_points, 0, batch, false);
+    std::vector<blst_p1> batched(batch);
+    GpuTiming gpu_timing = time_vulkan([&]() {
+        ComputeJob job = submit_msm(kernels, plan, points.data(), scalars.data(), batched.data());
+        job.wait();
+        return job.profile();
+    });
+    print_timing("Batched MSM (distinct bases)", gpu_timing);
+
+    bool match = true;
+    for (uint m = 0; m < batch; ++m) match = match && blst_p1_is_equal(&batched[m], &expected[m]);
+    std::cout << "Batched MSM (distinct bases) Verification: " << (match ? "PASSED" : "FAILED")
+              << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "msm_batch_bases";
+    result.shape = std::to_string(batch) + "x" + std::to_string(num_points);
+    result.throughput_unit = "points/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = (double)batch * num_points / cpu_ms * 1e3;
+    set_gpu_result(result, gpu_timing, 0.0, msm_kernel(kernels).setupMs);
+    result.gpu_throughput = (double)batch * num_points / gpu_compute_ms(gpu_timing) * 1e3;
+    result.verified = match;
+    return result;
+}
+
+// A tiled MatMul and an MSM, independent jobs submitted back to back so they land on different
+// compute queues (with their copies on the transfer queue), against the same two jobs run one after
+// the other
+BenchmarkResult benchmark_concurrent(KernelCache& kernels, const MatrixParams& params,
+                                     const MsmInputs& msm_inputs, uint num_points) {
+    const VulkanCompute& vk = *kernels.vk;
+    std::cout << "\nStarting Concurrent MatMul + MSM Benchmark..." << std::endl;
+    std::cout << "Compute queues: " << vk.computeQueues.size() << ", transfer queue: "
+              << (vk.transferQueue != VK_NULL_HANDLE ? "yes" : "no") << std::endl;
+    const blst_p1_affine* points = msm_inputs.points.data();
+    const blst_scalar* scalars = msm_inputs.scalars.data();
+
+    size_t sizeA = (size_t)params.batch * params.m * params.k;
+    size_t sizeB = (size_t)params.batch * params.k * params.n;
+    size_t sizeC = (size_t)params.batch * params.m * params.n;
+    std::vector<float> h_A(sizeA), h_B(sizeB), h_C_cpu(sizeC, 0.0f), h_C_gpu(sizeC);
+    for (size_t i = 0; i < sizeA; ++i) h_A[i] = static_cast<float>(rand()) / RAND_MAX;
+    for (size_t i = 0; i < sizeB; ++i) h_B[i] = static_cast<float>(rand()) / RAND_MAX;
 
-    double gpu_msm_time = run_vulkan(
-        vk, "build/msm.spv", &params_msm, sizeof(params_msm),
-        {(void*)h_points.data(), (void*)h_scalars.data()},
-        {h_points.size() * sizeof(float), h_scalars.size() * sizeof(float)}, h_res_gpu.data(),
-        h_res_gpu.size() * sizeof(float), (MSM_POINTS + 255) / 256, 1, 1);
-    std::cout << "Vulkan GPU MSM Time (Stub): " << gpu_msm_time << " ms" << std::endl;
+    auto start = std::chrono::high_resolution_clock::now();
+    cpu_matmul(h_A, h_B, h_C_cpu, params);
+    blst_p1 expected;
+    cpu_msm_parallel(points, scalars, num_points, &expected);
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << "CPU MatMul + MSM Time: " << cpu_ms << " ms" << std::endl;
+
+    MatmulTiling tiling = choose_matmul_tiling(vk);
+    std::vector<VulkanStage> stages = {{&params, sizeof(params),
+                                        (params.n + tiling.block_n() - 1) / tiling.block_n(),
+                                        (params.m + tiling.block_m() - 1) / tiling.block_m(),
+                                        params.batch}};
+    ComputeKernel& matmul = get_kernel(kernels, MATMUL_TILED_SHADER, stages, MATMUL_BINDINGS,
+                                       tiling.specialization());
+    std::vector<void*> inputs = {(void*)h_A.data(), (void*)h_B.data()};
+    std::vector<size_t> input_sizes = {sizeA * sizeof(float), sizeB * sizeof(float)};
+    MsmPlan plan(*kernels.vk, num_points);
+    blst_p1 gpu_sum;
+
+    auto run_sequential = [&]() {
+        matmul.submit(stages, inputs, input_sizes, {}, h_C_gpu.data(), sizeC * sizeof(float))
+            .wait();
+        submit_msm(kernels, plan, points, scalars, &gpu_sum).wait();
+    };
+    auto run_concurrent = [&]() {
+        ComputeJob matmul_job =
+            matmul.submit(stages, inputs, input_sizes, {}, h_C_gpu.data(), sizeC * sizeof(float));
+        ComputeJob msm_job = submit_msm(kernels, plan, points, scalars, &gpu_sum);
+        matmul_job.wait();
+        msm_job.wait();
+    };
+    auto time_runs = [&](auto run) {
+        auto first = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < WARM_RUNS; ++i) run();
+        auto last = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(last - first).count() / WARM_RUNS;
+    };
+
+    run_sequential();
+    double sequential_ms = time_runs(run_sequential);
+    start = std::chrono::high_resolution_clock::now();
+    run_concurrent();
+    end = std::chrono::high_resolution_clock::now();
+    double cold_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    double concurrent_ms = time_runs(run_concurrent);
+    std::cout << "Vulkan Sequential MatMul + MSM Time: " << sequential_ms << " ms" << std::endl;
+    std::cout << "Vulkan Concurrent MatMul + MSM Time: " << concurrent_ms << " ms" << std::endl;
+    std::cout << "Concurrent vs Sequential Speedup: " << sequential_ms / concurrent_ms << "x"
+              << std::endl;
+
+    bool match = blst_p1_is_equal(&gpu_sum, &expected);
+    for (size_t i = 0; i < sizeC && match; ++i) {
+        match = std::abs(h_C_cpu[i] - h_C_gpu[i]) <= 1e-3;
+    }
+    std::cout << "Concurrent Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "concurrent";
+    result.shape = std::to_string(params.batch) + "x" + std::to_string(params.m) + "x" +
+                   std::to_string(params.k) + "x" + std::to_string(params.n) + "+" +
+                   std::to_string(num_points);
+    result.throughput_unit = "jobs/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = 2.0 / cpu_ms * 1e3;
+    result.gpu_cold_ms = cold_ms;
+    result.gpu_warm_ms = concurrent_ms;
+    result.gpu_throughput = 2.0 / concurrent_ms * 1e3;
+    result.host = {matmul.setupMs + msm_kernel(kernels).setupMs, 0.0, concurrent_ms, 0.0};
+    result.verified = match;
+    return result;
+}
+
+const int HYBRID_RUNS = 6;
+
+// Split one MSM between all CPU cores and the GPU, repeating it so the split adapts to the measured
+// throughputs. The reported GPU times are those of the hybrid call.
+BenchmarkResult benchmark_hybrid_msm(KernelCache& kernels, const MsmInputs& msm_inputs,
+                                     uint num_points) {
+    std::cout << "\nStarting Hybrid CPU+GPU MSM Benchmark..." << std::endl;
+    const blst_p1_affine* points = msm_inputs.points.data();
+    const blst_scalar* scalars = msm_inputs.scalars.data();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    blst_p1 expected;
+    cpu_msm_blst(points, scalars, num_points, &expected);
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    HybridMsm hybrid;
+    hybrid.init(kernels);
+    bool match = true;
+    for (int i = 0; i < HYBRID_RUNS; ++i) {
+        blst_p1 sum;
+        hybrid.run(points, scalars, num_points, &sum);
+        match = match && blst_p1_is_equal(&sum, &expected);
+        const HybridMsmRun& run = hybrid.last;
+        std::cout << "Hybrid MSM Run " << i << ": CPU " << run.cpu_points << " points in "
+                  << run.cpu_ms << " ms, GPU " << run.gpu_points << " points in " << run.gpu_ms
+                  << " ms, total " << run.total_ms << " ms" << std::endl;
+    }
+    std::cout << "Hybrid MSM CPU Fraction: " << hybrid.cpu_fraction << std::endl;
+    std::cout << "Hybrid MSM Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "msm_hybrid";
+    result.shape = std::to_string(num_points);
+    result.throughput_unit = "points/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = num_points / cpu_ms * 1e3;
+    result.gpu_warm_ms = hybrid.last.total_ms;
+    result.gpu_throughput = num_points / hybrid.last.total_ms * 1e3;
+    result.verified = match;
+    return result;
+}
+
+// MSM over bases precomputed once and kept on the device, uploading only scalars per call. The
+// reported setup time is the table build (or load from `cache_path`) plus its upload.
+BenchmarkResult benchmark_fixed_base_msm(KernelCache& kernels, const MsmInputs& msm_inputs,
+                                         uint num_points, const std::string& cache_path) {
+    std::cout << "\nStarting Fixed-Base MSM Benchmark..." << std::endl;
+    const blst_p1_affine* points = msm_inputs.points.data();
+    const blst_scalar* scalars = msm_inputs.scalars.data();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    blst_p1 expected;
+    cpu_msm_blst(points, scalars, num_points, &expected);
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    FixedBaseMsm fixed;
+    fixed.init(*kernels.vk, points, num_points, cache_path);
+    std::cout << "Fixed-Base Table: " << fixed.plan.num_groups() << " groups of "
+              << fixed.plan.params.windows_per_group << " windows, "
+              << (fixed.loaded_from_cache ? "loaded" : "built") << " in " << fixed.precompute_ms
+              << " ms, uploaded in " << fixed.upload_ms << " ms" << std::endl;
+
+    blst_p1 sum;
+    GpuTiming gpu_timing = time_vulkan([&]() {
+        ComputeJob job = fixed.submit(scalars, &sum);
+        job.wait();
+        return job.profile();
+    });
+    print_timing("Fixed-Base MSM", gpu_timing);
+
+    std::vector<blst_p1> h_res_streamed(STREAM_JOBS);
+    double streamed_ms =
+        time_streamed([&](int i) { return fixed.submit(scalars, &h_res_streamed[i]); });
+    print_streamed("Fixed-Base MSM", streamed_ms);
+
+    bool match = blst_p1_is_equal(&sum, &expected);
+    std::cout << "Fixed-Base MSM Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "msm_fixed_base";
+    result.shape = std::to_string(num_points);
+    result.throughput_unit = "points/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = num_points / cpu_ms * 1e3;
+    set_gpu_result(result, gpu_timing, streamed_ms, fixed.precompute_ms + fixed.upload_ms);
+    result.gpu_throughput = num_points / gpu_compute_ms(gpu_timing) * 1e3;
+    result.verified = match;
+    fixed.destroy();
+    return result;
+}
+
+// Whether the table on `device` is exactly the host conversion of `points`
+bool device_points_match(DevicePoints& device, const blst_p1_affine* points) {
+    AlignedVector<uint32_t> device_table(device.plan.points_size() / sizeof(uint32_t));
+    device.download(device_table.data());
+    return device_table == msm_device_points(device.plan, points);
+}
+
+// MSM over points ingested in compressed form: 48 instead of 96 bytes a point are uploaded and
+// decompressed on the device into the resident layout msm.comp reads. The CPU side decompresses
+// with blst on every thread before its MSM; the reported setup time is the GPU's ingestion.
+BenchmarkResult benchmark_compressed_msm(KernelCache& kernels, const MsmInputs& msm_inputs,
+                                         uint num_points) {
+    std::cout << "\nStarting Compressed-Point MSM Benchmark..." << std::endl;
+    const blst_p1_affine* points = msm_inputs.points.data();
+    const blst_scalar* scalars = msm_inputs.scalars.data();
+    AlignedVector<byte> compressed = g1_compress_points(points, num_points);
+    const size_t encoded_size = G1_COMPRESSED_WORDS * sizeof(uint32_t);
+    size_t compressed_size = (size_t)num_points * encoded_size;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    PointVector decompressed(num_points);
+    long cpu_invalid = 0;
+#pragma omp parallel for schedule(static) reduction(+ : cpu_invalid)
+    for (long i = 0; i < (long)num_points; ++i) {
+        if (blst_p1_uncompress(&decompressed[i], &compressed[i * encoded_size]) != BLST_SUCCESS) {
+            ++cpu_invalid;
+        }
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    blst_p1 expected;
+    cpu_msm_parallel(decompressed.data(), scalars, num_points, &expected);
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_decompress_ms = std::chrono::duration<double, std::milli>(mid - start).count();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    bool cpu_match =
+        cpu_invalid == 0 &&
+        memcmp(decompressed.data(), points, num_points * sizeof(blst_p1_affine)) == 0;
+    std::cout << "CPU Decompression: " << cpu_decompress_ms << " ms, with MSM " << cpu_ms
+              << " ms" << std::endl;
+
+    // The transpose of affine points, over a count that leaves the last workgroup partial
+    uint affine_points = num_points % POINTS_WORKGROUP_SIZE != 0 ? num_points : num_points - 1;
+    DevicePoints affine;
+    affine.init(*kernels.vk, affine_points);
+    affine.load_affine(points);
+    bool affine_match = device_points_match(affine, points);
+    std::cout << "GPU Point Transpose: " << affine.upload_ms << " ms for "
+              << (size_t)affine_points * sizeof(blst_p1_affine) << " affine bytes, "
+              << (affine_match ? "PASSED" : "FAILED") << std::endl;
+    affine.destroy();
+
+    DevicePoints device;
+    device.init(*kernels.vk, num_points);
+    uint invalid = device.load_compressed(compressed.data());
+    bool table_match = invalid == 0 && device_points_match(device, points);
+    std::cout << "GPU Point Decompression: " << device.upload_ms << " ms for " << compressed_size
+              << " compressed bytes, " << (table_match ? "PASSED" : "FAILED") << " (" << invalid
+              << " invalid)" << std::endl;
+
+    blst_p1 sum;
+    GpuTiming gpu_timing = time_vulkan([&]() {
+        ComputeJob job = device.submit(scalars, &sum);
+        job.wait();
+        return job.profile();
+    });
+    print_timing("Compressed-Point MSM", gpu_timing);
+
+    std::vector<blst_p1> h_res_streamed(STREAM_JOBS);
+    double streamed_ms =
+        time_streamed([&](int i) { return device.submit(scalars, &h_res_streamed[i]); });
+    print_streamed("Compressed-Point MSM", streamed_ms);
+
+    bool match = blst_p1_is_equal(&sum, &expected);
+    std::cout << "Compressed-Point MSM Verification: " << (match ? "PASSED" : "FAILED")
+              << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "msm_compressed";
+    result.shape = std::to_string(num_points);
+    result.throughput_unit = "points/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = num_points / cpu_ms * 1e3;
+    set_gpu_result(result, gpu_timing, streamed_ms, device.upload_ms);
+    result.gpu_throughput = num_points / gpu_compute_ms(gpu_timing) * 1e3;
+    result.verified = match && cpu_match && table_match && affine_match;
+    device.destroy();
+    return result;
+}
+
+// MSM streamed through the device in chunks of `chunk_points` points (0: as many as fit), with
+// the bucket sums kept on the device between chunks. With `points_file` the points are written
+// there first and streamed from a memory mapping of the file.
+BenchmarkResult benchmark_streaming_msm(KernelCache& kernels, const MsmInputs& msm_inputs,
+                                        uint num_points, uint chunk_points,
+                                        const std::string& points_file) {
+    std::cout << "\nStarting Streaming MSM Benchmark..." << std::endl;
+    const blst_p1_affine* points = msm_inputs.points.data();
+    const blst_scalar* scalars = msm_inputs.scalars.data();
+
+    MappedFile mapped;
+    if (!points_file.empty()) {
+        if (!save_points(points_file, points, num_points) || !mapped.open(points_file) ||
+            mapped.size < (size_t)num_points * sizeof(blst_p1_affine)) {
+            std::cerr << "Failed to write or map points file " << points_file << std::endl;
+            exit(1);
+        }
+        points = reinterpret_cast<const blst_p1_affine*>(mapped.data);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    blst_p1 expected;
+    cpu_msm_parallel(points, scalars, num_points, &expected);
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    StreamingMsm streaming;
+    streaming.init(*kernels.vk);
+    blst_p1 sum;
+    GpuTiming gpu_timing = time_vulkan(
+        [&]() { return streaming.run(points, scalars, num_points, &sum, chunk_points); });
+    std::cout << "Streaming MSM: " << streaming.chunks << " chunks of up to "
+              << (num_points + streaming.chunks - 1) / streaming.chunks << " points"
+              << (points_file.empty() ? "" : ", mapped from " + points_file) << std::endl;
+    print_timing("Streaming MSM", gpu_timing);
+
+    bool match = blst_p1_is_equal(&sum, &expected);
+    std::cout << "Streaming MSM Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "msm_stream";
+    result.shape = std::to_string(num_points);
+    result.throughput_unit = "points/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = num_points / cpu_ms * 1e3;
+    set_gpu_result(result, gpu_timing, 0.0, streaming.kernel.setupMs);
+    result.gpu_throughput = num_points / gpu_timing.warm_ms * 1e3;
+    result.verified = match;
+    streaming.destroy();
+    return result;
+}
+
+// Print CPU and GPU throughput for each size of a sweep, grouped by benchmark name, and the
+// first size at which the GPU's warm call (including host copies) beats the CPU
+void print_sweep(const std::vector<BenchmarkResult>& results) {
+    std::vector<std::string> names;
+    for (const auto& r : results) {
+        if (std::find(names.begin(), names.end(), r.name) == names.end()) names.push_back(r.name);
+    }
+    for (const auto& name : names) {
+        std::cout << "\n--- Sweep: " << name << " ---" << std::endl;
+        std::cout << "shape, cpu ms, gpu warm ms, cpu throughput, gpu throughput, speedup"
+                  << std::endl;
+        const BenchmarkResult* crossover = nullptr;
+        for (const auto& r : results) {
+            if (r.name != name) continue;
+            double speedup = r.cpu_ms / r.gpu_warm_ms;
+            std::cout << r.shape << ", " << r.cpu_ms << ", " << r.gpu_warm_ms << ", "
+                      << r.cpu_throughput << ", " << r.gpu_throughput << " " << r.throughput_unit
+                      << ", " << speedup << "x" << std::endl;
+            if (!crossover && speedup > 1.0) crossover = &r;
+        }
+        if (crossover) {
+            std::cout << name << " crossover: GPU wins from " << crossover->shape << std::endl;
+        } else {
+            std::cout << name << " crossover: GPU never wins in this range" << std::endl;
+        }
+    }
+}
+
+// Forward and inverse transforms of 2^log_n random values, plain and over the coset, each on the
+// GPU checked against the CPU. The inverse rows also require the CPU inverse to undo the forward
+// transform. The reported setup time is the twiddle table upload.
+std::vector<BenchmarkResult> benchmark_ntt(KernelCache& kernels, uint log_n) {
+    std::cout << "\nStarting NTT Benchmark (2^" << log_n << " values)..." << std::endl;
+    // Before the CPU side allocates a transform the device cannot hold
+    uint max_log_n = gpu_ntt_max_log_n(*kernels.vk);
+    if (log_n > max_log_n) {
+        std::cerr << "--ntt-log " << log_n << " exceeds this device's storage buffers (at most "
+                  << max_log_n << ")" << std::endl;
+        exit(1);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    NttDomain domain = make_ntt_domain(log_n);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "NTT Domain: twiddles computed in "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+              << std::endl;
+    uint n = domain.n;
+
+    // Below 2^254 < r, so every value is already reduced
+    std::vector<blst_fr> values(n);
+    for (uint i = 0; i < n; ++i) {
+        uint64_t limbs[4];
+        for (int j = 0; j < 4; ++j) limbs[j] = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+        limbs[3] &= 0x3fffffffffffffffull;
+        blst_fr_from_uint64(&values[i], limbs);
+    }
+
+    GpuNtt ntt;
+    ntt.init(*kernels.vk, domain);
+    std::cout << "NTT Table: uploaded in " << ntt.upload_ms << " ms" << std::endl;
+
+    std::vector<BenchmarkResult> results;
+    for (int variant = 0; variant < 4; ++variant) {
+        bool inverse = variant & 1;
+        bool coset = variant & 2;
+        std::string name = std::string(inverse ? "intt" : "ntt") + (coset ? "_coset" : "");
+        std::string label = std::string(coset ? "Coset " : "") + (inverse ? "iNTT" : "NTT");
+
+        std::vector<blst_fr> expected = values;
+        start = std::chrono::high_resolution_clock::now();
+        cpu_ntt(expected.data(), domain, inverse, coset);
+        end = std::chrono::high_resolution_clock::now();
+        double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << "\nCPU " << label << " Time (" << omp_get_max_threads()
+                  << " threads): " << cpu_ms << " ms" << std::endl;
+
+        bool round_trip = true;
+        if (inverse) {
+            std::vector<blst_fr> back = expected;
+            cpu_ntt(back.data(), domain, false, coset);
+            round_trip = memcmp(back.data(), values.data(), n * sizeof(blst_fr)) == 0;
+            std::cout << "CPU " << label << " Round Trip: " << (round_trip ? "PASSED" : "FAILED")
+                      << std::endl;
+        }
+
+        std::vector<blst_fr> gpu(n);
+        GpuTiming gpu_timing = time_vulkan([&]() {
+            ComputeJob job = ntt.submit(values.data(), gpu.data(), inverse, coset);
+            job.wait();
+            return job.profile();
+        });
+        print_timing(label.c_str(), gpu_timing);
+
+        std::vector<std::vector<blst_fr>> streamed(STREAM_JOBS, std::vector<blst_fr>(n));
+        double streamed_ms = time_streamed([&](int i) {
+            return ntt.submit(values.data(), streamed[i].data(), inverse, coset);
+        });
+        print_streamed(label.c_str(), streamed_ms);
+
+        bool match = round_trip;
+        for (uint i = 0; i < n && match; ++i) {
+            if (memcmp(&gpu[i], &expected[i], sizeof(blst_fr)) != 0) {
+                match = false;
+                std::cout << label << " Mismatch at " << i << std::endl;
+            }
+        }
+        std::cout << label << " Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+        BenchmarkResult result = {};
+        result.name = name;
+        result.shape = std::to_string(n);
+        result.throughput_unit = "values/s";
+        result.cpu_ms = cpu_ms;
+        result.cpu_throughput = n / cpu_ms * 1e3;
+        set_gpu_result(result, gpu_timing, streamed_ms, ntt.upload_ms);
+        result.gpu_throughput = n / gpu_compute_ms(gpu_timing) * 1e3;
+        result.verified = match;
+        results.push_back(result);
+    }
+    ntt.destroy();
+    return results;
+}
+
+const uint SWEEP_MIN_DIM = 16;
+const uint SWEEP_MIN_MSM_POINTS = 1 << 8;
+
+// Square matmuls from SWEEP_MIN_DIM up to the largest of --m, --k and --n, doubling each step
+std::vector<BenchmarkResult> sweep_matmul(KernelCache& kernels, const MatrixParams& max_params,
+                                          MatmulBackend backend) {
+    uint max_dim = std::max({max_params.m, max_params.k, max_params.n});
+    std::vector<BenchmarkResult> results;
+    for (uint64_t dim = SWEEP_MIN_DIM; dim <= max_dim; dim *= 2) {
+        MatrixParams params = {max_params.batch, (uint)dim, (uint)dim, (uint)dim};
+        for (const auto& result : benchmark_matmul(kernels, params, backend)) {
+            results.push_back(result);
+        }
+    }
+    return results;
+}
+
+// MSMs from SWEEP_MIN_MSM_POINTS up to --msm-points, doubling each step, over prefixes of one
+// generated input set
+std::vector<BenchmarkResult> sweep_msm(KernelCache& kernels, uint max_points, bool hybrid,
+                                       bool fixed_base) {
+    MsmInputs msm_inputs = generate_msm_inputs(max_points);
+    std::vector<BenchmarkResult> results;
+    for (uint64_t points = std::min(SWEEP_MIN_MSM_POINTS, max_points); points <= max_points;
+         points *= 2) {
+        results.push_back(benchmark_msm(kernels, msm_inputs, (uint)points));
+        if (hybrid) results.push_back(benchmark_hybrid_msm(kernels, msm_inputs, (uint)points));
+        if (fixed_base) {
+            results.push_back(benchmark_fixed_base_msm(kernels, msm_inputs, (uint)points, ""));
+        }
+    }
+    return results;
+}
+
+// One MatMul batch split by batch index across the devices of `group`, each shard running the
+// tiled kernel with the tiling chosen for its own device and writing its slice of C directly
+BenchmarkResult benchmark_sharded_matmul(DeviceGroup& group, const MatrixParams& params) {
+    size_t sizeA = (size_t)params.batch * params.m * params.k;
+    size_t sizeB = (size_t)params.batch * params.k * params.n;
+    size_t sizeC = (size_t)params.batch * params.m * params.n;
+    std::vector<float> h_A(sizeA), h_B(sizeB), h_C_cpu(sizeC), h_C_gpu(sizeC);
+    for (size_t i = 0; i < sizeA; ++i) h_A[i] = static_cast<float>(rand()) / RAND_MAX;
+    for (size_t i = 0; i < sizeB; ++i) h_B[i] = static_cast<float>(rand()) / RAND_MAX;
+
+    size_t shards = group.devices.size();
+    std::cout << "\nStarting Sharded MatMul Benchmark (" << shards << " devices)..." << std::endl;
+    auto start = std::chrono::high_resolution_clock::now();
+    cpu_matmul(h_A, h_B, h_C_cpu, params);
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    // Parameters and stages per shard; they must outlive the submissions
+    std::vector<MatrixParams> shard_params(shards);
+    std::vector<std::vector<VulkanStage>> shard_stages(shards);
+    std::vector<ComputeKernel*> shard_kernels(shards, nullptr);
+    std::vector<uint> first_batch(shards);
+    for (size_t d = 0; d < shards; ++d) {
+        first_batch[d] = (uint)(params.batch * d / shards);
+        shard_params[d] = params;
+        shard_params[d].batch = (uint)(params.batch * (d + 1) / shards) - first_batch[d];
+        if (shard_params[d].batch == 0) continue;
+        MatmulTiling tiling = choose_matmul_tiling(group.devices[d]);
+        shard_stages[d] = {{&shard_params[d], sizeof(MatrixParams),
+                            (params.n + tiling.block_n() - 1) / tiling.block_n(),
+                            (params.m + tiling.block_m() - 1) / tiling.block_m(),
+                            shard_params[d].batch}};
+        shard_kernels[d] = &get_kernel(group.kernels[d], MATMUL_TILED_SHADER, shard_stages[d],
+                                       MATMUL_BINDINGS, tiling.specialization());
+    }
+
+    auto run = [&]() {
+        std::vector<ComputeJob> jobs(shards);
+        for (size_t d = 0; d < shards; ++d) {
+            if (!shard_kernels[d]) continue;
+            size_t b = first_batch[d];
+            std::vector<void*> inputs = {(void*)(h_A.data() + b * params.m * params.k),
+                                         (void*)(h_B.data() + b * params.k * params.n)};
+            std::vector<size_t> input_sizes = {
+                (size_t)shard_params[d].batch * params.m * params.k * sizeof(float),
+                (size_t)shard_params[d].batch * params.k * params.n * sizeof(float)};
+            jobs[d] = shard_kernels[d]->submit(
+                shard_stages[d], inputs, input_sizes, {}, h_C_gpu.data() + b * params.m * params.n,
+                (size_t)shard_params[d].batch * params.m * params.n * sizeof(float));
+        }
+        for (size_t d = 0; d < shards; ++d) {
+            if (shard_kernels[d]) jobs[d].wait();
+        }
+    };
+    start = std::chrono::high_resolution_clock::now();
+    run();
+    end = std::chrono::high_resolution_clock::now();
+    double cold_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < WARM_RUNS; ++i) run();
+    end = std::chrono::high_resolution_clock::now();
+    double warm_ms = std::chrono::duration<double, std::milli>(end - start).count() / WARM_RUNS;
+    std::cout << "Vulkan Sharded MatMul Cold Start: " << cold_ms << " ms" << std::endl;
+    std::cout << "Vulkan Sharded MatMul Warm Call: " << warm_ms << " ms" << std::endl;
+
+    bool match = true;
+    for (size_t i = 0; i < sizeC && match; ++i) {
+        match = std::abs(h_C_cpu[i] - h_C_gpu[i]) <= 1e-3;
+    }
+    std::cout << "Sharded MatMul Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    double flops = 2.0 * params.batch * params.m * params.n * params.k;
+    BenchmarkResult result = {};
+    result.name = "matmul_sharded";
+    result.shape = std::to_string(params.batch) + "x" + std::to_string(params.m) + "x" +
+                   std::to_string(params.k) + "x" + std::to_string(params.n);
+    result.throughput_unit = "GFLOP/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = flops / cpu_ms / 1e6;
+    result.gpu_cold_ms = cold_ms;
+    result.gpu_warm_ms = warm_ms;
+    result.gpu_throughput = flops / warm_ms / 1e6;
+    result.verified = match;
+    return result;
+}
+
+// One MSM split by point range across the devices of `group`
+BenchmarkResult benchmark_sharded_msm(DeviceGroup& group, const MsmInputs& msm_inputs,
+                                      uint num_points) {
+    size_t shards = group.devices.size();
+    std::cout << "\nStarting Sharded MSM Benchmark (" << shards << " devices)..." << std::endl;
+    const blst_p1_affine* points = msm_inputs.points.data();
+    const blst_scalar* scalars = msm_inputs.scalars.data();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    blst_p1 expected;
+    cpu_msm_parallel(points, scalars, num_points, &expected);
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    blst_p1 sum;
+    start = std::chrono::high_resolution_clock::now();
+    sharded_msm(group, points, scalars, num_points, &sum);
+    end = std::chrono::high_resolution_clock::now();
+    double cold_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < WARM_RUNS; ++i) sharded_msm(group, points, scalars, num_points, &sum);
+    end = std::chrono::high_resolution_clock::now();
+    double warm_ms = std::chrono::duration<double, std::milli>(end - start).count() / WARM_RUNS;
+    std::cout << "Vulkan Sharded MSM Cold Start: " << cold_ms << " ms" << std::endl;
+    std::cout << "Vulkan Sharded MSM Warm Call: " << warm_ms << " ms" << std::endl;
+
+    bool match = blst_p1_is_equal(&sum, &expected);
+    std::cout << "Sharded MSM Verification: " << (match ? "PASSED" : "FAILED") << std::endl;
+
+    BenchmarkResult result = {};
+    result.name = "msm_sharded";
+    result.shape = std::to_string(num_points);
+    result.throughput_unit = "points/s";
+    result.cpu_ms = cpu_ms;
+    result.cpu_throughput = num_points / cpu_ms * 1e3;
+    result.gpu_cold_ms = cold_ms;
+    result.gpu_warm_ms = warm_ms;
+    result.gpu_throughput = num_points / warm_ms * 1e3;
+    result.verified = match;
+    return result;
+}
+
+// --device: an index, a device type ("discrete", "integrated", "virtual", "cpu", "other") or a
+// name substring
+DeviceSelector parse_device(const char* value) {
+    DeviceSelector selector;
+    if (!value) {
+        std::cerr << "--device expects an index, a type or a name" << std::endl;
+        exit(1);
+    }
+    std::string spec = value;
+    if (!spec.empty() && std::all_of(spec.begin(), spec.end(), ::isdigit)) {
+        selector.index = atoi(value);
+    } else if (parse_device_type(spec) >= 0) {
+        selector.type = parse_device_type(spec);
+    } else {
+        selector.name = spec;
+    }
+    return selector;
+}
+
+MatmulBackend parse_matmul_backend(const char* value) {
+    std::string name = value ? value : "";
+    if (name == "auto") return MATMUL_AUTO;
+    if (name == "naive") return MATMUL_NAIVE;
+    if (name == "tiled") return MATMUL_TILED;
+    if (name == "coopmat") return MATMUL_COOPMAT;
+    std::cerr << "--matmul-backend expects auto, naive, tiled or coopmat" << std::endl;
+    exit(1);
+}
+
+// Parse a positive integer option value, exiting with a message on anything else
+uint parse_size(const char* option, const char* value) {
+    char* end = nullptr;
+    unsigned long parsed = value ? strtoul(value, &end, 10) : 0;
+    if (!value || *end != '\0' || parsed == 0 || parsed > UINT32_MAX) {
+        std::cerr << option << " expects a positive integer" << std::endl;
+        exit(1);
+    }
+    return (uint)parsed;
+}
+
+// The value of an option naming a file or directory (`what`), exiting with a message when it is
+// missing
+const char* parse_path(const char* option, const char* value, const char* what) {
+    if (!value) {
+        std::cerr << option << " expects a " << what << std::endl;
+        exit(1);
+    }
+    return value;
 }
 
 int main(int argc, char** argv) {
     bool show_info = false;
     bool do_matmul = false;
     bool do_msm = false;
+    bool do_ntt = false;
+    uint ntt_log_n = DEFAULT_NTT_LOG_N;
+    uint field_check = 0;  // 0: no check
+    bool sweep = false;
+    bool hybrid = false;
+    bool fixed_base = false;
+    uint msm_batch = 0;
+    bool msm_sort = false;
+    bool msm_compressed = false;
+    DeviceSelector device_selector;
+    bool multi_device = false;
+    uint multi_device_count = 0;  // 0: every matching device
+    std::string fixed_base_cache;
+    bool msm_stream = false;
+    uint msm_chunk = 0;  // 0: as many points as fit on the device
+    std::string msm_points_file;
+    bool warm_up = true;
+    bool concurrent = false;
+    QueueConfig queue_config;
+    std::string pipeline_cache_dir = default_pipeline_cache_dir();
+    bool json = false;
+    bool csv = false;
+    MatrixParams matmul_params = {DEFAULT_BATCH, DEFAULT_M, DEFAULT_K, DEFAULT_N};
+    MatmulBackend matmul_backend = MATMUL_AUTO;
+    uint msm_points = DEFAULT_MSM_POINTS;
 
-    if (argc == 1) {
-        do_matmul = true;
-        do_msm = true;
-    } else {
-        for (int i = 1; i < argc; ++i) {
-            std::string arg = argv[i];
-            if (arg == "--info")
-                show_info = true;
-            else if (arg == "--matmul")
-                do_matmul = true;
-            else if (arg == "--msm")
-                do_msm = true;
-            else if (arg == "--all") {
-                do_matmul = true;
-                do_msm = true;
-            } else {
-                std::cerr << "Unknown argument: " << arg << std::endl;
-                std::cerr << "Usage: " << argv[0] << " [--matmul] [--msm] [--all]" << std::endl;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--info")
+            show_info = true;
+        else if (arg == "--matmul")
+            do_matmul = true;
+        else if (arg == "--msm")
+            do_msm = true;
+        else if (arg == "--ntt")
+            do_ntt = true;
+        else if (arg == "--ntt-log") {
+            do_ntt = true;
+            ntt_log_n = parse_size("--ntt-log", value);
+            if (ntt_log_n > NTT_MAX_SIZE_LOG_N) {
+                std::cerr << "--ntt-log must be at most " << NTT_MAX_SIZE_LOG_N << std::endl;
                 return 1;
             }
+            ++i;
+        } else if (arg == "--field-check") {
+            field_check = parse_size("--field-check", value);
+            ++i;
+        } else if (arg == "--all") {
+            do_matmul = true;
+            do_msm = true;
+        } else if (arg == "--sweep")
+            sweep = true;
+        else if (arg == "--hybrid")
+            hybrid = true;
+        else if (arg == "--fixed-base")
+            fixed_base = true;
+        else if (arg == "--fixed-base-cache") {
+            fixed_base = true;
+            fixed_base_cache = parse_path("--fixed-base-cache", value, "FILE");
+            ++i;
+        } else if (arg == "--device") {
+            device_selector = parse_device(value);
+            ++i;
+        } else if (arg == "--multi-device") {
+            multi_device = true;
+            if (!value || strcmp(value, "all") != 0) {
+                multi_device_count = parse_size("--multi-device", value);
+            }
+            ++i;
+        } else if (arg == "--compute-queues") {
+            queue_config.maxComputeQueues = parse_size("--compute-queues", value);
+            ++i;
+        } else if (arg == "--no-transfer-queue")
+            queue_config.transferQueue = false;
+        else if (arg == "--concurrent")
+            concurrent = true;
+        else if (arg == "--no-warm-up")
+            warm_up = false;
+        else if (arg == "--pipeline-cache") {
+            pipeline_cache_dir = parse_path("--pipeline-cache", value, "DIR or off");
+            if (pipeline_cache_dir == "off") pipeline_cache_dir = "";
+            ++i;
+        } else if (arg == "--msm-stream")
+            msm_stream = true;
+        else if (arg == "--msm-chunk") {
+            msm_stream = true;
+            msm_chunk = parse_size("--msm-chunk", value);
+            ++i;
+        } else if (arg == "--msm-points-file") {
+            msm_stream = true;
+            msm_points_file = parse_path("--msm-points-file", value, "FILE");
+            ++i;
+        } else if (arg == "--msm-sort")
+            msm_sort = true;
+        else if (arg == "--msm-compressed")
+            msm_compressed = true;
+        else if (arg == "--msm-batch") {
+            msm_batch = parse_size("--msm-batch", value);
+            ++i;
+        } else if (arg == "--matmul-backend") {
+            do_matmul = true;
+            matmul_backend = parse_matmul_backend(value);
+            ++i;
+        } else if (arg == "--batch") {
+            matmul_params.batch = parse_size("--batch", value);
+            ++i;
+        } else if (arg == "--m") {
+            matmul_params.m = parse_size("--m", value);
+            ++i;
+        } else if (arg == "--k") {
+            matmul_params.k = parse_size("--k", value);
+            ++i;
+        } else if (arg == "--n") {
+            matmul_params.n = parse_size("--n", value);
+            ++i;
+        } else if (arg == "--msm-points") {
+            msm_points = parse_size("--msm-points", value);
+            ++i;
+        } else if (arg == "--json")
+            json = true;
+        else if (arg == "--csv")
+            csv = true;
+        else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            std::cerr << "Usage: " << argv[0] << " [--matmul] [--msm] [--all] [--info]"
+                      << " [--batch B] [--m M] [--k K] [--n N] [--msm-points P] [--sweep]"
+                      << " [--hybrid] [--fixed-base] [--fixed-base-cache FILE] [--msm-batch N]"
+                      << " [--msm-sort] [--msm-compressed] [--device INDEX|TYPE|NAME]"
+                      << " [--multi-device N|all]"
+                      << " [--pipeline-cache DIR|off] [--no-warm-up] [--compute-queues N]"
+                      << " [--no-transfer-queue] [--concurrent] [--msm-stream] [--msm-chunk P]"
+                      << " [--msm-points-file FILE] [--matmul-backend auto|naive|tiled|coopmat]"
+                      << " [--ntt] [--ntt-log N] [--field-check N] [--json | --csv]"
+                      << std::endl;
+            return 1;
         }
     }
+    // A sweep builds one table per size, and the cache file holds only one
+    if (sweep && !fixed_base_cache.empty()) {
+        std::cerr << "--fixed-base-cache cannot be combined with --sweep" << std::endl;
+        return 1;
+    }
+    // Checks the shader arithmetic on the CPU alone, so it runs without a Vulkan device
+    if (field_check > 0) return run_field_check(field_check) ? 0 : 1;
+
+    if (!do_matmul && !do_msm && !do_ntt && !show_info) {
+        do_matmul = true;
+        do_msm = true;
+    }
+
+    // Keep stdout for the machine-readable report; progress goes to stderr
+    std::streambuf* stdout_buf = std::cout.rdbuf();
+    if (json || csv) std::cout.rdbuf(std::cerr.rdbuf());
 
     VulkanCompute vk;
-    vk.init(show_info);
+    vk.init(show_info, device_selector, pipeline_cache_dir, queue_config);
+
+    KernelCache kernels;
+    kernels.init(vk);
+
+    // Sharded runs open their own instance with every selected device
+    DeviceGroup group;
+    if (multi_device) {
+        group.init(device_selector, multi_device_count, show_info, pipeline_cache_dir,
+                   queue_config);
+    }
+
+    if (warm_up) {
+        bool standalone_sort = do_msm && msm_sort && !sweep;
+        bool tiled_matmul =
+            (do_matmul && runs_tiled(matmul_backend)) || (do_msm && concurrent && !sweep);
+        warm_up_kernels(kernels,
+                        startup_kernels(vk, do_matmul, tiled_matmul, do_msm, standalone_sort,
+                                        do_ntt, matmul_backend),
+                        "Device");
+        for (size_t d = 0; multi_device && d < group.devices.size(); ++d) {
+            warm_up_kernels(group.kernels[d],
+                            startup_kernels(group.devices[d], false, do_matmul && !sweep,
+                                            do_msm && !sweep, false),
+                            "Shard " + std::to_string(d));
+        }
+    }
 
+    std::vector<BenchmarkResult> results;
     if (show_info) show_vk_info(vk);
-    if (do_matmul) benchmark_matmul(vk);
-    if (do_msm) benchmark_msm(vk);
+    if (do_matmul) {
+        std::vector<BenchmarkResult> matmul =
+            sweep ? sweep_matmul(kernels, matmul_params, matmul_backend)
+                  : benchmark_matmul(kernels, matmul_params, matmul_backend);
+        results.insert(results.end(), matmul.begin(), matmul.end());
+        if (multi_device && !sweep) {
+            results.push_back(benchmark_sharded_matmul(group, matmul_params));
+        }
+    }
+    if (do_msm) {
+        if (sweep) {
+            std::vector<BenchmarkResult> msm = sweep_msm(kernels, msm_points, hybrid, fixed_base);
+            results.insert(results.end(), msm.begin(), msm.end());
+        } else {
+            MsmInputs msm_inputs = generate_msm_inputs(msm_points);
+            results.push_back(benchmark_msm(kernels, msm_inputs, msm_points));
+            if (hybrid) results.push_back(benchmark_hybrid_msm(kernels, msm_inputs, msm_points));
+            if (msm_sort) results.push_back(benchmark_msm_sort(kernels, msm_inputs, msm_points));
+            if (msm_batch > 0) {
+                results.push_back(
+                    benchmark_batched_msm(kernels, msm_inputs, msm_points, msm_batch));
+                results.push_back(benchmark_batched_msm_distinct_bases(kernels, msm_inputs,
+                                                                       msm_points, msm_batch));
+            }
+            if (fixed_base) {
+                results.push_back(benchmark_fixed_base_msm(kernels, msm_inputs, msm_points,
+                                                           fixed_base_cache));
+            }
+            if (msm_compressed) {
+                results.push_back(benchmark_compressed_msm(kernels, msm_inputs, msm_points));
+            }
+            if (msm_stream) {
+                results.push_back(benchmark_streaming_msm(kernels, msm_inputs, msm_points,
+                                                          msm_chunk, msm_points_file));
+            }
+            if (multi_device) {
+                results.push_back(benchmark_sharded_msm(group, msm_inputs, msm_points));
+            }
+            if (concurrent) {
+                results.push_back(
+                    benchmark_concurrent(kernels, matmul_params, msm_inputs, msm_points));
+            }
+        }
+    }
+    if (do_ntt) {
+        std::vector<BenchmarkResult> ntt = benchmark_ntt(kernels, ntt_log_n);
+        results.insert(results.end(), ntt.begin(), ntt.end());
+    }
+    if (sweep) print_sweep(results);
+    if (multi_device) group.cleanup();
 
+    kernels.destroy();
     vk.cleanup();
+
+    std::cout.rdbuf(stdout_buf);
+    if (json) write_json(std::cout, results);
+    if (csv) write_csv(std::cout, results);
     return 0;
 }
@@ -0,0 +1,72 @@
+#include "point_layout.h"
+
+#include <immintrin.h>
+#include <omp.h>
+
+// Points per AVX2 transpose: eight rows of eight words
+const size_t SOA_BLOCK = 8;
+
+static_assert(sizeof(blst_p1_affine) == G1_SOA_WORDS * sizeof(uint32_t),
+              "the device layout holds every word of blst_p1_affine");
+
+// rows[k] holds eight consecutive words of point k; afterwards rows[w] holds word w of points
+// 0-7
+static void transpose8x8(__m256i rows[8]) {
+    __m256i t[8], u[8];
+    for (int k = 0; k < 8; k += 2) {
+        t[k] = _mm256_unpacklo_epi32(rows[k], rows[k + 1]);
+        t[k + 1] = _mm256_unpackhi_epi32(rows[k], rows[k + 1]);
+    }
+    for (int k = 0; k < 8; k += 4) {
+        u[k] = _mm256_unpacklo_epi64(t[k], t[k + 2]);
+        u[k + 1] = _mm256_unpackhi_epi64(t[k], t[k + 2]);
+        u[k + 2] = _mm256_unpacklo_epi64(t[k + 1], t[k + 3]);
+        u[k + 3] = _mm256_unpackhi_epi64(t[k + 1], t[k + 3]);
+    }
+    for (int k = 0; k < 4; ++k) {
+        rows[k] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x20);
+        rows[k + 4] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x31);
+    }
+}
+
+void g1_points_to_soa(const blst_p1_affine* points, size_t n, uint32_t* soa) {
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(points);
+    long blocks = (long)(n / SOA_BLOCK);
+#pragma omp parallel for schedule(static)
+    for (long b = 0; b < blocks; ++b) {
+        size_t first = (size_t)b * SOA_BLOCK;
+        for (uint chunk = 0; chunk < G1_SOA_WORDS; chunk += 8) {
+            __m256i rows[8];
+            for (int k = 0; k < 8; ++k) {
+                const uint32_t* src = words + (first + k) * G1_SOA_WORDS + chunk;
+                rows[k] = _mm256_loadu_si256((const __m256i*)src);
+            }
+            transpose8x8(rows);
+            for (uint w = 0; w < 8; ++w) {
+                uint32_t* dst = soa + g1_soa_index((uint)n, (uint)first, chunk + w);
+                _mm256_storeu_si256((__m256i*)dst, rows[w]);
+            }
+        }
+    }
+    for (size_t i = (size_t)blocks * SOA_BLOCK; i < n; ++i) {
+        for (uint w = 0; w < G1_SOA_WORDS; ++w) {
+            soa[g1_soa_index((uint)n, (uint)i, w)] = words[i * G1_SOA_WORDS + w];
+        }
+    }
+}
+
+void g1_tables_to_soa(const blst_p1_affine* points, size_t n, size_t tables, uint32_t* soa) {
+    for (size_t t = 0; t < tables; ++t) {
+        g1_points_to_soa(points + t * n, n, soa + t * n * G1_SOA_WORDS);
+    }
+}
+
+AlignedVector<byte> g1_compress_points(const blst_p1_affine* points, size_t n) {
+    AlignedVector<byte> compressed(n * G1_COMPRESSED_WORDS * sizeof(uint32_t));
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long)n; ++i) {
+        blst_p1_affine_compress(&compressed[i * G1_COMPRESSED_WORDS * sizeof(uint32_t)],
+                                &points[i]);
+    }
+    return compressed;
+}
@@ -0,0 +1,68 @@
+#ifndef POINT_LAYOUT_H
+#define POINT_LAYOUT_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#include "blst.h"
+#include "common.h"
+
+// Host buffers of points, scalars and device-layout words start on a cache line, which the SIMD
+// conversions and the staging copies rely on for aligned loads
+const size_t HOST_BUFFER_ALIGNMENT = 64;
+
+template <typename T>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        size_t bytes = (n * sizeof(T) + HOST_BUFFER_ALIGNMENT - 1) / HOST_BUFFER_ALIGNMENT *
+                       HOST_BUFFER_ALIGNMENT;
+#if defined(_MSC_VER)
+        void* p = _aligned_malloc(bytes, HOST_BUFFER_ALIGNMENT);
+#else
+        void* p = aligned_alloc(HOST_BUFFER_ALIGNMENT, bytes);
+#endif
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t) {
+#if defined(_MSC_VER)
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+typedef AlignedVector<blst_p1_affine> PointVector;
+typedef AlignedVector<blst_scalar> ScalarVector;
+
+// `n` points in blst's layout to the device layout of g1_soa_index (G1_SOA_WORDS * n words),
+// transposing eight points at a time with AVX2 on every OpenMP thread
+void g1_points_to_soa(const blst_p1_affine* points, size_t n, uint32_t* soa);
+
+// `tables` consecutive tables of `n` points each, converted table by table into `soa`
+void g1_tables_to_soa(const blst_p1_affine* points, size_t n, size_t tables, uint32_t* soa);
+
+// The 48-byte compressed form of each point, as blst_p1_affine_compress writes it
+AlignedVector<byte> g1_compress_points(const blst_p1_affine* points, size_t n);
+
+#endif  // POINT_LAYOUT_H
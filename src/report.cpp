@@ -0,0 +1,38 @@
+#include "report.h"
+
+void write_json(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& r = results[i];
+        out << "  {\"name\": \"" << r.name << "\", \"shape\": \"" << r.shape << "\""
+            << ", \"throughput_unit\": \"" << r.throughput_unit << "\""
+            << ", \"cpu_ms\": " << r.cpu_ms << ", \"cpu_throughput\": " << r.cpu_throughput
+            << ", \"gpu_cold_ms\": " << r.gpu_cold_ms << ", \"gpu_warm_ms\": " << r.gpu_warm_ms
+            << ", \"gpu_streamed_ms\": " << r.gpu_streamed_ms
+            << ", \"gpu_throughput\": " << r.gpu_throughput << ",\n   \"host\": {\"setup_ms\": "
+            << r.host.setup_ms << ", \"upload_ms\": " << r.host.upload_ms
+            << ", \"compute_ms\": " << r.host.compute_ms
+            << ", \"readback_ms\": " << r.host.readback_ms << "}"
+            << ", \"device\": {\"upload_ms\": " << r.device.upload_ms
+            << ", \"compute_ms\": " << r.device.compute_ms
+            << ", \"readback_ms\": " << r.device.readback_ms << "}"
+            << ", \"verified\": " << (r.verified ? "true" : "false") << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]" << std::endl;
+}
+
+void write_csv(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    out << "name,shape,throughput_unit,cpu_ms,cpu_throughput,gpu_cold_ms,gpu_warm_ms,"
+           "gpu_streamed_ms,gpu_throughput,host_setup_ms,host_upload_ms,host_compute_ms,"
+           "host_readback_ms,device_upload_ms,device_compute_ms,device_readback_ms,verified\n";
+    for (const BenchmarkResult& r : results) {
+        out << r.name << "," << r.shape << "," << r.throughput_unit << "," << r.cpu_ms << ","
+            << r.cpu_throughput << "," << r.gpu_cold_ms << "," << r.gpu_warm_ms << ","
+            << r.gpu_streamed_ms << "," << r.gpu_throughput << "," << r.host.setup_ms << ","
+            << r.host.upload_ms << "," << r.host.compute_ms << "," << r.host.readback_ms << ","
+            << r.device.upload_ms << "," << r.device.compute_ms << "," << r.device.readback_ms
+            << "," << (r.verified ? 1 : 0) << "\n";
+    }
+    out.flush();
+}
@@ -0,0 +1,35 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Host phase times are wall clock; device phase times come from GPU timestamps (0 if unsupported)
+struct PhaseTimes {
+    double setup_ms;
+    double upload_ms;
+    double compute_ms;
+    double readback_ms;
+};
+
+// One benchmark run, as written by --json and --csv
+struct BenchmarkResult {
+    std::string name;             // "matmul", "msm"
+    std::string shape;            // e.g. "32x128x128x128" or "65536"
+    std::string throughput_unit;  // "GFLOP/s", "points/s"
+    double cpu_ms;
+    double cpu_throughput;
+    double gpu_cold_ms;      // first call, including pipeline creation
+    double gpu_warm_ms;      // later synchronous calls, including host copies
+    double gpu_streamed_ms;  // per job with several jobs in flight
+    double gpu_throughput;   // from the warm device compute time
+    PhaseTimes host;
+    PhaseTimes device;
+    bool verified;
+};
+
+void write_json(std::ostream& out, const std::vector<BenchmarkResult>& results);
+void write_csv(std::ostream& out, const std::vector<BenchmarkResult>& results);
+
+#endif  // REPORT_H
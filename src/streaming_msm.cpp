@@ -0,0 +1,171 @@
+#include "streaming_msm.h"
+
+#include <algorithm>
+#include <fstream>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Share of the largest device-local heap the in-flight chunks may take
+const uint64_t STREAMING_HEAP_FRACTION = 4;
+
+uint streaming_chunk_points(const VulkanCompute& vk, uint window_bits) {
+    const VkPhysicalDeviceMemoryProperties& props = vk.memory.memProperties;
+    uint64_t heap = 0;
+    for (uint32_t i = 0; i < props.memoryHeapCount; ++i) {
+        if (props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            heap = std::max<uint64_t>(heap, props.memoryHeaps[i].size);
+        }
+    }
+    uint num_windows = msm_num_windows(window_bits);
+    uint64_t per_point =
+        sizeof(blst_p1_affine) + sizeof(blst_scalar) + (uint64_t)num_windows * sizeof(uint32_t);
+    uint64_t points = heap / STREAMING_HEAP_FRACTION / FRAMES_IN_FLIGHT / per_point;
+
+    uint64_t range = vk.limits.maxStorageBufferRange;
+    points = std::min<uint64_t>(points, range / sizeof(blst_p1_affine));
+    uint64_t list_entries = range / sizeof(uint32_t) / num_windows;
+    uint64_t buckets = msm_num_buckets(window_bits);
+    points = std::min<uint64_t>(points, list_entries > buckets ? list_entries - buckets : 0);
+    points = std::min<uint64_t>(points, 1u << 30) & ~uint64_t(63);
+    return (uint)std::max<uint64_t>(points, 64);
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER file_size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(file);
+    if (mapping == nullptr) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr) return false;
+    size = (size_t)file_size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+    // Chunks are read front to back, once
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+    size = (size_t)st.st_size;
+#endif
+    data = static_cast<const uint8_t*>(view);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data == nullptr) return;
+#if defined(_WIN32)
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool save_points(const std::string& path, const blst_p1_affine* points, uint n) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    file.write(reinterpret_cast<const char*>(points), (size_t)n * sizeof(blst_p1_affine));
+    return file.good();
+}
+
+void StreamingMsm::init(VulkanCompute& vk_ref) {
+    vk = &vk_ref;
+    init_msm_kernel(kernel, *vk);
+    kernel.inOrder = true;
+}
+
+DispatchProfile StreamingMsm::run(const blst_p1_affine* points, const blst_scalar* scalars,
+                                  uint n, blst_p1* result, uint chunk_points) {
+    uint window_bits = msm_window_bits(n);
+    if (chunk_points == 0) chunk_points = streaming_chunk_points(*vk, window_bits);
+    chunk_points = std::max(1u, std::min(chunk_points, n));
+    chunks = (n + chunk_points - 1) / chunk_points;
+
+    // Every chunk shares the window size of the whole MSM and the segment count of a full chunk,
+    // so they all index the one bucket buffer the same way. Fitting the full chunk to the device
+    // spreads the sort passes of every chunk over its workgroup grid and rejects a chunk_points
+    // whose buffers exceed maxStorageBufferRange.
+    MsmPlan full(chunk_points);
+    full.params.window_bits = window_bits;
+    full.params.num_windows = msm_num_windows(window_bits);
+    full.params.windows_per_group = full.params.num_windows;
+    full.update();
+    full.fit(*vk);
+    if (buckets.size < full.buckets_size()) {
+        GpuBuffer grown = vk->createStorageBuffer(full.buckets_size());
+        kernel.bindResident(3, grown);  // after the jobs still using the old buffer
+        vk->destroyBuffer(buckets);
+        buckets = grown;
+    }
+
+    // Chunks are timed as one run: each phase adds up over the chunks
+    DispatchProfile profile;
+    auto add = [&](const DispatchProfile& chunk) {
+        profile.hostUploadMs += chunk.hostUploadMs;
+        profile.hostWaitMs += chunk.hostWaitMs;
+        profile.hostReadbackMs += chunk.hostReadbackMs;
+        profile.gpuUploadMs += chunk.gpuUploadMs;
+        profile.gpuComputeMs += chunk.gpuComputeMs;
+        profile.gpuReadbackMs += chunk.gpuReadbackMs;
+    };
+    std::vector<ComputeJob> jobs(chunks);
+    for (uint c = 0; c < chunks; ++c) {
+        // The job whose frame this chunk reuses, completed here so its timings are not lost
+        if (c >= FRAMES_IN_FLIGHT) {
+            jobs[c - FRAMES_IN_FLIGHT].wait();
+            add(jobs[c - FRAMES_IN_FLIGHT].profile());
+        }
+
+        uint begin = c * chunk_points;
+        uint count = std::min(chunk_points, n - begin);
+        bool last = c + 1 == chunks;
+
+        // Push constants are recorded at submit, so the plan need not outlive it
+        MsmPlan plan = full;
+        plan.params.points = count;
+        plan.params.accumulate = c > 0 ? 1 : 0;
+        plan.update();
+        std::vector<VulkanStage> stages = plan.stages();
+        if (!last) stages.resize(MSM_STAGE_MERGE + 1);
+
+        // The chunk's points go from the caller's array, or mapping, straight into staging
+        std::vector<void*> inputs = {nullptr, (void*)(scalars + begin)};
+        std::vector<size_t> input_sizes = {plan.points_size(), plan.scalars_size()};
+        jobs[c] = kernel.submit(stages, inputs, input_sizes, plan.scratch_sizes,
+                                last ? (void*)result : (void*)&discard, sizeof(blst_p1),
+                                {msm_points_writer(plan, points + begin)});
+    }
+    for (uint c = chunks > FRAMES_IN_FLIGHT ? chunks - FRAMES_IN_FLIGHT : 0; c < chunks; ++c) {
+        jobs[c].wait();
+        add(jobs[c].profile());
+    }
+    return profile;
+}
+
+void StreamingMsm::destroy() {
+    kernel.destroy();
+    vk->destroyBuffer(buckets);
+}
@@ -0,0 +1,52 @@
+#ifndef STREAMING_MSM_H
+#define STREAMING_MSM_H
+
+#include <string>
+
+#include "blst.h"
+#include "common.h"
+#include "gpu_msm.h"
+#include "vulkan_helper.h"
+
+// Largest chunk of points whose per-frame buffers (points, scalars and bucket lists) stay within
+// maxStorageBufferRange and, with FRAMES_IN_FLIGHT chunks in flight, a quarter of the largest
+// device-local heap
+uint streaming_chunk_points(const VulkanCompute& vk, uint window_bits);
+
+// Read-only mapping of a whole file, so points can be streamed from disk into the staging buffers
+// without first being read into host memory
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    bool open(const std::string& path);
+    void close();
+    ~MappedFile() { close(); }
+};
+
+// Write `points` as the raw blst_p1_affine array MappedFile and StreamingMsm read back
+bool save_points(const std::string& path, const blst_p1_affine* points, uint n);
+
+// MSM over more points than fit on the device at once. Points and scalars pass through in chunks,
+// up to FRAMES_IN_FLIGHT of them uploaded while an earlier one is computed, each chunk's points
+// converted to the device layout as they are copied into staging. Every chunk adds its bucket sums
+// into one resident bucket buffer, and only the last chunk runs the window reduction and
+// combination. Single MSMs only; the window size follows the total point count.
+struct StreamingMsm {
+    VulkanCompute* vk = nullptr;
+    ComputeKernel kernel;
+    GpuBuffer buckets;  // [window][segment][bucket], segment 0 carrying the sums across chunks
+    uint chunks = 0;    // chunks of the last run()
+    blst_p1 discard;    // readback target of every chunk but the last
+
+    void init(VulkanCompute& vk_ref);
+
+    // sum(scalars[i] * points[i]) for i < n, in chunks of `chunk_points` points (0 picks the
+    // largest streaming_chunk_points allows). Returns once `result` holds the sum.
+    DispatchProfile run(const blst_p1_affine* points, const blst_scalar* scalars, uint n,
+                        blst_p1* result, uint chunk_points = 0);
+
+    void destroy();
+};
+
+#endif  // STREAMING_MSM_H
@@ -1,12 +1,27 @@
+#ifndef VULKAN_HELPER_H
+#define VULKAN_HELPER_H
+
 #define VK_ENABLE_BETA_EXTENSIONS
 
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "common.h"
+#include "embedded_shaders.h"
 
 #define VK_CHECK(x)                                                                  \
     do {                                                                             \
@@ -17,39 +32,685 @@
         }                                                                            \
     } while (0)
 
-struct VulkanCompute {
-    VkInstance instance;
-    VkPhysicalDevice physicalDevice;
+// A suballocated range of device memory
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    uint8_t* mapped = nullptr;  // host pointer when the block is host visible
+    uint32_t block = 0;
+};
+
+struct MemoryBlock {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    uint32_t memoryTypeIndex = 0;
+    uint8_t* mapped = nullptr;
+    bool dedicated = false;
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges;  // offset -> size
+};
+
+// First-fit suballocator over large vkAllocateMemory blocks, one block list per memory type.
+// Requests larger than half a block get a dedicated allocation. The number of live blocks never
+// exceeds maxMemoryAllocationCount.
+struct MemoryPool {
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memProperties;
+    uint32_t maxAllocations;
+    uint32_t liveBlocks = 0;
+    VkDeviceSize blockSize = VkDeviceSize(64) << 20;
+    std::vector<MemoryBlock> blocks;
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice dev) {
+        device = dev;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        maxAllocations = props.limits.maxMemoryAllocationCount;
+    }
+
+    // Prefer a type with all of required | preferred, else any type with required
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required,
+                            VkMemoryPropertyFlags preferred) const {
+        VkMemoryPropertyFlags wanted[2] = {required | preferred, required};
+        for (VkMemoryPropertyFlags flags : wanted) {
+            for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+                if ((typeBits & (1u << i)) &&
+                    (memProperties.memoryTypes[i].propertyFlags & flags) == flags) {
+                    return i;
+                }
+            }
+        }
+        return uint32_t(-1);
+    }
+
+    bool isHostVisible(uint32_t memoryTypeIndex) const {
+        return memProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    }
+
+    uint32_t createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated) {
+        if (liveBlocks >= maxAllocations) {
+            std::cerr << "Memory allocation count limit (" << maxAllocations << ") reached"
+                      << std::endl;
+            exit(1);
+        }
+
+        MemoryBlock block;
+        VkMemoryAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+        VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &block.memory));
+        if (isHostVisible(memoryTypeIndex)) {
+            void* mapped;
+            VK_CHECK(vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+            block.mapped = static_cast<uint8_t*>(mapped);
+        }
+        block.size = size;
+        block.memoryTypeIndex = memoryTypeIndex;
+        block.dedicated = dedicated;
+        block.freeRanges[0] = size;
+        liveBlocks++;
+
+        // Reuse a slot left by a freed dedicated block
+        for (uint32_t i = 0; i < blocks.size(); ++i) {
+            if (blocks[i].memory == VK_NULL_HANDLE) {
+                blocks[i] = block;
+                return i;
+            }
+        }
+        blocks.push_back(block);
+        return blocks.size() - 1;
+    }
+
+    bool carve(uint32_t blockIndex, const VkMemoryRequirements& reqs, Allocation* allocation) {
+        MemoryBlock& block = blocks[blockIndex];
+        for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+            VkDeviceSize start = it->first;
+            VkDeviceSize end = it->first + it->second;
+            VkDeviceSize aligned = (start + reqs.alignment - 1) / reqs.alignment * reqs.alignment;
+            if (aligned + reqs.size > end) continue;
+
+            block.freeRanges.erase(it);
+            if (aligned > start) block.freeRanges[start] = aligned - start;
+            if (aligned + reqs.size < end) {
+                block.freeRanges[aligned + reqs.size] = end - aligned - reqs.size;
+            }
+            allocation->memory = block.memory;
+            allocation->offset = aligned;
+            allocation->size = reqs.size;
+            allocation->mapped = block.mapped ? block.mapped + aligned : nullptr;
+            allocation->block = blockIndex;
+            return true;
+        }
+        return false;
+    }
+
+    Allocation allocate(const VkMemoryRequirements& reqs, VkMemoryPropertyFlags required,
+                        VkMemoryPropertyFlags preferred = 0) {
+        uint32_t memoryTypeIndex = findMemoryType(reqs.memoryTypeBits, required, preferred);
+        if (memoryTypeIndex == uint32_t(-1)) {
+            std::cerr << "No memory type with property flags " << required << std::endl;
+            exit(1);
+        }
+
+        Allocation allocation;
+        for (uint32_t i = 0; i < blocks.size(); ++i) {
+            if (blocks[i].memory == VK_NULL_HANDLE || blocks[i].dedicated ||
+                blocks[i].memoryTypeIndex != memoryTypeIndex) {
+                continue;
+            }
+            if (carve(i, reqs, &allocation)) return allocation;
+        }
+
+        bool dedicated = reqs.size > blockSize / 2;
+        uint32_t blockIndex =
+            createBlock(memoryTypeIndex, dedicated ? reqs.size : blockSize, dedicated);
+        carve(blockIndex, reqs, &allocation);
+        return allocation;
+    }
+
+    void free(const Allocation& allocation) {
+        if (allocation.memory == VK_NULL_HANDLE) return;
+        MemoryBlock& block = blocks[allocation.block];
+        if (block.dedicated) {
+            vkFreeMemory(device, block.memory, nullptr);
+            block = MemoryBlock();
+            liveBlocks--;
+            return;
+        }
+
+        // Return the range and coalesce with its neighbours
+        auto it = block.freeRanges.emplace(allocation.offset, allocation.size).first;
+        auto next = std::next(it);
+        if (next != block.freeRanges.end() && it->first + it->second == next->first) {
+            it->second += next->second;
+            block.freeRanges.erase(next);
+        }
+        if (it != block.freeRanges.begin()) {
+            auto prev = std::prev(it);
+            if (prev->first + prev->second == it->first) {
+                prev->second += it->second;
+                block.freeRanges.erase(it);
+            }
+        }
+    }
+
+    void destroy() {
+        for (auto& block : blocks) {
+            if (block.memory != VK_NULL_HANDLE) vkFreeMemory(device, block.memory, nullptr);
+        }
+        blocks.clear();
+        liveBlocks = 0;
+    }
+};
+
+struct GpuBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation allocation;
+    VkDeviceSize size = 0;
+};
+
+// Host-visible staging buffers used round-robin for uploads to and readbacks from device-local
+// buffers. A slot is only waited on when it comes round again, so the memcpy into one slot
+// overlaps the copy out of the previous one.
+struct StagingRing {
+    struct Slot {
+        GpuBuffer buffer;
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+        bool pending = false;
+        void* readbackDst = nullptr;  // host destination to fill once the copy has completed
+        VkDeviceSize readbackSize = 0;
+    };
+
     VkDevice device;
     VkQueue queue;
-    uint32_t queueFamilyIndex;
+    VkCommandPool commandPool;
+    VkDeviceSize slotSize;
+    std::vector<Slot> slots;
+    uint32_t next = 0;
 
-    void init(bool verbose = false) {
-        if (verbose) std::cout << "Initializing Vulkan..." << std::endl;
+    void init(VkDevice dev, VkQueue q, uint32_t queueFamilyIndex, MemoryPool& pool,
+              uint32_t count = 3, VkDeviceSize size = VkDeviceSize(16) << 20) {
+        device = dev;
+        queue = q;
+        slotSize = size;
+
+        VkCommandPoolCreateInfo cmdPoolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+        VK_CHECK(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+
+        slots.resize(count);
+        for (auto& slot : slots) {
+            VkBufferCreateInfo bufferInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+            bufferInfo.size = slotSize;
+            bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &slot.buffer.buffer));
+            VkMemoryRequirements memReqs;
+            vkGetBufferMemoryRequirements(device, slot.buffer.buffer, &memReqs);
+            // Cached memory keeps readback memcpy fast
+            slot.buffer.allocation = pool.allocate(
+                memReqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+            VK_CHECK(vkBindBufferMemory(device, slot.buffer.buffer, slot.buffer.allocation.memory,
+                                        slot.buffer.allocation.offset));
+            slot.buffer.size = slotSize;
+
+            VkCommandBufferAllocateInfo allocInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+            allocInfo.commandPool = commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer));
+
+            VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+            VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &slot.fence));
+        }
+    }
 
-        VkApplicationInfo appInfo = {VK_STRUCTURE_TYPE_APPLICATION_INFO};
-        appInfo.pApplicationName = "Vulkan GPU Crypto";
-        appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+    void complete(Slot& slot) {
+        if (!slot.pending) return;
+        VK_CHECK(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+        VK_CHECK(vkResetFences(device, 1, &slot.fence));
+        if (slot.readbackDst) {
+            memcpy(slot.readbackDst, slot.buffer.allocation.mapped, slot.readbackSize);
+            slot.readbackDst = nullptr;
+        }
+        slot.pending = false;
+    }
+
+    Slot& acquire() {
+        Slot& slot = slots[next];
+        next = (next + 1) % slots.size();
+        complete(slot);
+        return slot;
+    }
+
+    void submitCopy(Slot& slot, VkBuffer src, VkBuffer dst, VkDeviceSize srcOffset,
+                    VkDeviceSize dstOffset, VkDeviceSize size) {
+        VK_CHECK(vkResetCommandBuffer(slot.commandBuffer, 0));
+        VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(slot.commandBuffer, &beginInfo));
+        VkBufferCopy region = {srcOffset, dstOffset, size};
+        vkCmdCopyBuffer(slot.commandBuffer, src, dst, 1, &region);
+        VK_CHECK(vkEndCommandBuffer(slot.commandBuffer));
 
-        VkInstanceCreateInfo createInfo = {VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
-        createInfo.pApplicationInfo = &appInfo;
-        VK_CHECK(vkCreateInstance(&createInfo, nullptr, &instance));
-        if (verbose) std::cout << "Vulkan Instance created." << std::endl;
+        VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &slot.commandBuffer;
+        VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, slot.fence));
+        slot.pending = true;
+    }
 
-        uint32_t deviceCount = 0;
-        vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
-        std::vector<VkPhysicalDevice> devices(deviceCount);
-        vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
-        physicalDevice = devices[0];  // Just take the first one for simplicity
+    // Returns once the data is staged; the copies complete ahead of later work on the same queue
+    void upload(VkBuffer dst, VkDeviceSize dstOffset, const void* src, VkDeviceSize size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(src);
+        for (VkDeviceSize done = 0; done < size; done += slotSize) {
+            VkDeviceSize chunk = std::min(slotSize, size - done);
+            Slot& slot = acquire();
+            memcpy(slot.buffer.allocation.mapped, bytes + done, chunk);
+            submitCopy(slot, slot.buffer.buffer, dst, 0, dstOffset + done, chunk);
+        }
+    }
+
+    void download(VkBuffer src, VkDeviceSize srcOffset, void* dst, VkDeviceSize size) {
+        uint8_t* bytes = static_cast<uint8_t*>(dst);
+        for (VkDeviceSize done = 0; done < size; done += slotSize) {
+            VkDeviceSize chunk = std::min(slotSize, size - done);
+            Slot& slot = acquire();
+            submitCopy(slot, src, slot.buffer.buffer, srcOffset + done, 0, chunk);
+            slot.readbackDst = bytes + done;
+            slot.readbackSize = chunk;
+        }
+        flush();
+    }
 
+    // Wait for every in-flight copy and finish pending readbacks
+    void flush() {
+        for (auto& slot : slots) complete(slot);
+    }
+
+    void destroy(MemoryPool& pool) {
+        flush();
+        for (auto& slot : slots) {
+            vkDestroyFence(device, slot.fence, nullptr);
+            vkDestroyBuffer(device, slot.buffer.buffer, nullptr);
+            pool.free(slot.buffer.allocation);
+        }
+        slots.clear();
+        vkDestroyCommandPool(device, commandPool, nullptr);
+    }
+};
+
+// Which physical device(s) to use. Unset fields match every device; matches are ordered by
+// device_score, best first.
+struct DeviceSelector {
+    int index = -1;    // position in vkEnumeratePhysicalDevices order
+    std::string name;  // case-insensitive substring of deviceName
+    int type = -1;     // VkPhysicalDeviceType
+};
+
+// "discrete", "integrated", "virtual", "cpu" or "other" as a VkPhysicalDeviceType, -1 otherwise
+inline int parse_device_type(const std::string& name) {
+    if (name == "discrete") return VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+    if (name == "integrated") return VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+    if (name == "virtual") return VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU;
+    if (name == "cpu") return VK_PHYSICAL_DEVICE_TYPE_CPU;
+    if (name == "other") return VK_PHYSICAL_DEVICE_TYPE_OTHER;
+    return -1;
+}
+
+// Heuristic preference: device type first (discrete, integrated, virtual, CPU, other), then the
+// size of device-local memory
+inline uint64_t device_score(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    uint64_t typeRank = 0;
+    switch (props.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            typeRank = 4;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            typeRank = 3;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            typeRank = 2;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            typeRank = 1;
+            break;
+        default:
+            break;
+    }
+
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+    uint64_t localMb = 0;
+    for (uint32_t i = 0; i < memProps.memoryHeapCount; i++) {
+        if (memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            localMb += memProps.memoryHeaps[i].size >> 20;
+        }
+    }
+    return (typeRank << 40) | std::min<uint64_t>(localMb, (1ull << 40) - 1);
+}
+
+inline VkInstance create_instance(bool verbose) {
+    VkApplicationInfo appInfo = {VK_STRUCTURE_TYPE_APPLICATION_INFO};
+    appInfo.pApplicationName = "Vulkan GPU Crypto";
+    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+
+    VkInstanceCreateInfo createInfo = {VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+    createInfo.pApplicationInfo = &appInfo;
+    VkInstance instance;
+    VK_CHECK(vkCreateInstance(&createInfo, nullptr, &instance));
+    if (verbose) std::cout << "Vulkan Instance created." << std::endl;
+    return instance;
+}
+
+// Physical devices matching `selector`, best device_score first. Exits when none match.
+inline std::vector<VkPhysicalDevice> select_physical_devices(VkInstance instance,
+                                                             const DeviceSelector& selector,
+                                                             bool verbose) {
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+    std::string wanted = selector.name;
+    std::transform(wanted.begin(), wanted.end(), wanted.begin(), ::tolower);
+
+    if (verbose) std::cout << "available devices: " << deviceCount << std::endl;
+    std::vector<VkPhysicalDevice> matches;
+    for (uint32_t i = 0; i < deviceCount; i++) {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(devices[i], &props);
+        std::string name = props.deviceName;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
         if (verbose) {
-            std::cout << "available devices: " << deviceCount << std::endl;
-            for (uint32_t i = 0; i < deviceCount; i++) {
-                VkPhysicalDeviceProperties deviceProperties;
-                vkGetPhysicalDeviceProperties(devices[i], &deviceProperties);
-                std::cout << "Device " << i << ": " << deviceProperties.deviceName << std::endl;
+            std::cout << "Device " << i << ": " << props.deviceName << " (type "
+                      << props.deviceType << ", score " << device_score(devices[i]) << ")"
+                      << std::endl;
+        }
+        if (selector.index >= 0 && (uint32_t)selector.index != i) continue;
+        if (selector.type >= 0 && props.deviceType != (VkPhysicalDeviceType)selector.type) {
+            continue;
+        }
+        if (!wanted.empty() && name.find(wanted) == std::string::npos) continue;
+        matches.push_back(devices[i]);
+    }
+    if (matches.empty()) {
+        std::cerr << "No Vulkan device matches the device selection!" << std::endl;
+        exit(1);
+    }
+    std::stable_sort(matches.begin(), matches.end(),
+                     [](VkPhysicalDevice a, VkPhysicalDevice b) {
+                         return device_score(a) > device_score(b);
+                     });
+    return matches;
+}
+
+// Where pipeline caches persist between runs: $VGC_PIPELINE_CACHE_DIR, else vulkan-gpu-crypto under
+// the user's cache directory. Empty, so nothing is saved, when no such directory is known.
+inline std::string default_pipeline_cache_dir() {
+    if (const char* dir = getenv("VGC_PIPELINE_CACHE_DIR")) return dir;
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) return std::string(xdg) + "/vulkan-gpu-crypto";
+    if (const char* home = getenv("HOME")) return std::string(home) + "/.cache/vulkan-gpu-crypto";
+    if (const char* local = getenv("LOCALAPPDATA")) {
+        return std::string(local) + "/vulkan-gpu-crypto";
+    }
+    return "";
+}
+
+// One cache file per device UUID and driver version, so another GPU or a driver update starts
+// from an empty cache instead of overwriting or reusing this one
+inline std::string pipeline_cache_file(const std::string& dir, VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    VkPhysicalDeviceIDProperties idProps = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES};
+    const uint8_t* uuid = props.pipelineCacheUUID;  // Vulkan 1.0 has no device UUID
+    if (props.apiVersion >= VK_API_VERSION_1_1) {
+        VkPhysicalDeviceProperties2 props2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+        props2.pNext = &idProps;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &props2);
+        uuid = idProps.deviceUUID;
+    }
+    static const char hex[] = "0123456789abcdef";
+    std::string name = dir + "/pipelines-";
+    for (uint32_t i = 0; i < VK_UUID_SIZE; ++i) {
+        name += hex[uuid[i] >> 4];
+        name += hex[uuid[i] & 15];
+    }
+    return name + "-" + std::to_string(props.driverVersion) + ".bin";
+}
+
+inline bool device_has_extension(VkPhysicalDevice physicalDevice, const char* name) {
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> extensions(count);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+    for (const auto& extension : extensions) {
+        if (strcmp(extension.extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
+// Optional device features the benchmarks use when present, queried together and chained into
+// VkDeviceCreateInfo: the packed 8-bit dot product for the int8 MatMul, and cooperative matrices
+// with the fp16 storage and arithmetic and the Vulkan memory model their shaders need. The KHR
+// cooperative matrix extension is preferred over the older NV one.
+struct DeviceFeatures {
+    VkPhysicalDeviceShaderIntegerDotProductFeaturesKHR dot = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_INTEGER_DOT_PRODUCT_FEATURES_KHR};
+    VkPhysicalDeviceCooperativeMatrixFeaturesKHR coopMatrix = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_COOPERATIVE_MATRIX_FEATURES_KHR};
+    VkPhysicalDeviceCooperativeMatrixFeaturesNV coopMatrixNV = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_COOPERATIVE_MATRIX_FEATURES_NV};
+    VkPhysicalDevice16BitStorageFeatures storage16 = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES};
+    VkPhysicalDeviceShaderFloat16Int8FeaturesKHR float16 = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR};
+    VkPhysicalDeviceVulkanMemoryModelFeaturesKHR memoryModel = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_MEMORY_MODEL_FEATURES_KHR};
+
+    void* chain = nullptr;                // pNext of VkDeviceCreateInfo
+    std::vector<const char*> extensions;  // to enable
+    bool integerDotProduct = false;
+    bool integerDotProductAccelerated = false;
+    bool cooperativeMatrix = false;
+    bool cooperativeMatrixNV = false;
+
+    // Decide what to enable on `physicalDevice`. Queries need vkGetPhysicalDeviceFeatures2, so
+    // Vulkan 1.0 devices get none of these.
+    void query(VkPhysicalDevice physicalDevice) {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        if (props.apiVersion < VK_API_VERSION_1_1) return;
+        auto has = [&](const char* name) { return device_has_extension(physicalDevice, name); };
+        bool hasDot = has(VK_KHR_SHADER_INTEGER_DOT_PRODUCT_EXTENSION_NAME);
+        bool hasCoop = has(VK_KHR_COOPERATIVE_MATRIX_EXTENSION_NAME);
+        bool hasCoopNV = !hasCoop && has(VK_NV_COOPERATIVE_MATRIX_EXTENSION_NAME);
+        bool hasFloat16 = has(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME);
+        bool hasMemoryModel = has(VK_KHR_VULKAN_MEMORY_MODEL_EXTENSION_NAME);
+
+        chain = nullptr;
+        if (hasDot) link(dot);
+        if (hasCoop) link(coopMatrix);
+        if (hasCoopNV) link(coopMatrixNV);
+        link(storage16);  // core in Vulkan 1.1
+        if (hasFloat16) link(float16);
+        if (hasMemoryModel) link(memoryModel);
+        VkPhysicalDeviceFeatures2 features2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+        features2.pNext = chain;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        integerDotProduct = hasDot && dot.shaderIntegerDotProduct;
+        if (integerDotProduct) {
+            VkPhysicalDeviceShaderIntegerDotProductPropertiesKHR dotProps = {
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_INTEGER_DOT_PRODUCT_PROPERTIES_KHR};
+            VkPhysicalDeviceProperties2 props2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+            props2.pNext = &dotProps;
+            vkGetPhysicalDeviceProperties2(physicalDevice, &props2);
+            integerDotProductAccelerated = dotProps.integerDotProduct4x8BitPackedSignedAccelerated;
+        }
+        bool coop = hasCoop ? coopMatrix.cooperativeMatrix
+                            : hasCoopNV && coopMatrixNV.cooperativeMatrix;
+        cooperativeMatrix = coop && storage16.storageBuffer16BitAccess && hasFloat16 &&
+                            float16.shaderFloat16 && hasMemoryModel &&
+                            memoryModel.vulkanMemoryModel;
+        cooperativeMatrixNV = cooperativeMatrix && hasCoopNV;
+
+        // Chain only what is used, each struct with every feature the device reported
+        chain = nullptr;
+        extensions.clear();
+        if (integerDotProduct) {
+            link(dot);
+            extensions.push_back(VK_KHR_SHADER_INTEGER_DOT_PRODUCT_EXTENSION_NAME);
+        }
+        if (cooperativeMatrix) {
+            if (cooperativeMatrixNV) {
+                link(coopMatrixNV);
+                extensions.push_back(VK_NV_COOPERATIVE_MATRIX_EXTENSION_NAME);
+            } else {
+                link(coopMatrix);
+                extensions.push_back(VK_KHR_COOPERATIVE_MATRIX_EXTENSION_NAME);
             }
+            link(storage16);
+            link(float16);
+            link(memoryModel);
+            extensions.push_back(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_VULKAN_MEMORY_MODEL_EXTENSION_NAME);
+        }
+    }
+
+   private:
+    template <typename T>
+    void link(T& features) {
+        features.pNext = chain;
+        chain = &features;
+    }
+};
+
+// One MxNxK shape of C (MxN) += A (MxK) * B (KxN) that a subgroup can multiply as cooperative
+// matrices, with fp16 A and B and an fp32 accumulator
+struct CooperativeMatrixShape {
+    uint32_t m, n, k;
+};
+
+inline std::vector<CooperativeMatrixShape> query_cooperative_matrix_shapes(
+    VkInstance instance, VkPhysicalDevice physicalDevice, bool nv) {
+    std::vector<CooperativeMatrixShape> shapes;
+    uint32_t count = 0;
+    if (nv) {
+        auto getProperties = (PFN_vkGetPhysicalDeviceCooperativeMatrixPropertiesNV)
+            vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCooperativeMatrixPropertiesNV");
+        if (!getProperties) return shapes;
+        getProperties(physicalDevice, &count, nullptr);
+        std::vector<VkCooperativeMatrixPropertiesNV> props(
+            count, {VK_STRUCTURE_TYPE_COOPERATIVE_MATRIX_PROPERTIES_NV});
+        getProperties(physicalDevice, &count, props.data());
+        for (const auto& p : props) {
+            if (p.AType == VK_COMPONENT_TYPE_FLOAT16_NV &&
+                p.BType == VK_COMPONENT_TYPE_FLOAT16_NV &&
+                p.CType == VK_COMPONENT_TYPE_FLOAT32_NV &&
+                p.DType == VK_COMPONENT_TYPE_FLOAT32_NV && p.scope == VK_SCOPE_SUBGROUP_NV) {
+                shapes.push_back({p.MSize, p.NSize, p.KSize});
+            }
+        }
+    } else {
+        auto getProperties = (PFN_vkGetPhysicalDeviceCooperativeMatrixPropertiesKHR)
+            vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCooperativeMatrixPropertiesKHR");
+        if (!getProperties) return shapes;
+        getProperties(physicalDevice, &count, nullptr);
+        std::vector<VkCooperativeMatrixPropertiesKHR> props(
+            count, {VK_STRUCTURE_TYPE_COOPERATIVE_MATRIX_PROPERTIES_KHR});
+        getProperties(physicalDevice, &count, props.data());
+        for (const auto& p : props) {
+            if (p.AType == VK_COMPONENT_TYPE_FLOAT16_KHR &&
+                p.BType == VK_COMPONENT_TYPE_FLOAT16_KHR &&
+                p.CType == VK_COMPONENT_TYPE_FLOAT32_KHR &&
+                p.ResultType == VK_COMPONENT_TYPE_FLOAT32_KHR && !p.saturatingAccumulation &&
+                p.scope == VK_SCOPE_SUBGROUP_KHR) {
+                shapes.push_back({p.MSize, p.NSize, p.KSize});
+            }
+        }
+    }
+    return shapes;
+}
+
+// How many queues to open. The compute queues all come from one family, the compute family with
+// the most queues (preferring one without graphics, i.e. async compute); the transfer queue is from
+// a family with neither compute nor graphics, usually the GPU's DMA engine.
+struct QueueConfig {
+    uint32_t maxComputeQueues = 4;
+    bool transferQueue = true;
+};
+
+const uint32_t NO_QUEUE_FAMILY = ~0u;
+
+struct VulkanCompute {
+    VkInstance instance;
+    bool ownsInstance;  // false when the instance is shared, e.g. by a DeviceGroup
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue queue;              // computeQueues[0]
+    uint32_t queueFamilyIndex;  // family of every compute queue
+    std::vector<VkQueue> computeQueues;
+    uint32_t nextComputeQueue;                 // round robin position, see ComputeKernel::submit
+    VkQueue transferQueue;                     // VK_NULL_HANDLE without a dedicated transfer family
+    uint32_t transferFamilyIndex;              // NO_QUEUE_FAMILY without one
+    std::vector<uint32_t> queueFamilyIndices;  // every family with an open queue
+    MemoryPool memory;
+    StagingRing staging;
+    bool unifiedMemory;  // every heap is device local (integrated/UMA), so skip staging copies
+    uint32_t timestampValidBits;  // 0 when the compute queue cannot write timestamps
+    float timestampPeriod;        // ns per timestamp tick
+    VkPhysicalDeviceLimits limits;
+    uint32_t subgroupSize;  // invocations per subgroup, 0 when the device predates Vulkan 1.1
+    VkSubgroupFeatureFlags subgroupOperations;  // usable in compute shaders, 0 before Vulkan 1.1
+    // VK_KHR_shader_integer_dot_product enabled, and its packed signed 8-bit form runs natively
+    // rather than being lowered to shifts and multiplies by the driver
+    bool integerDotProduct;
+    bool integerDotProductAccelerated;
+    // fp16 cooperative matrix shapes, empty without VK_KHR_cooperative_matrix or
+    // VK_NV_cooperative_matrix (or the fp16 and memory model features their shaders need)
+    std::vector<CooperativeMatrixShape> cooperativeMatrixShapes;
+    bool cooperativeMatrixNV;  // the shapes and shaders are those of the NV extension
+    VkPipelineCache pipelineCache;
+    std::string pipelineCachePath;  // empty when the cache is not saved
+    size_t pipelineCacheLoaded;     // bytes of valid cache data read at startup
+
+    // Every one of `operations` (VK_SUBGROUP_FEATURE_*_BIT) is available to compute shaders
+    bool hasSubgroupOperations(VkSubgroupFeatureFlags operations) const {
+        return (subgroupOperations & operations) == operations;
+    }
+
+    // Create an instance and open the best device matching `selector`. Pipelines are cached in
+    // `pipelineCacheDir`, or only for this run when it is empty.
+    void init(bool verbose = false, const DeviceSelector& selector = DeviceSelector(),
+              const std::string& pipelineCacheDir = default_pipeline_cache_dir(),
+              const QueueConfig& queueConfig = QueueConfig()) {
+        if (verbose) std::cout << "Initializing Vulkan..." << std::endl;
+        VkInstance newInstance = create_instance(verbose);
+        initDevice(newInstance, select_physical_devices(newInstance, selector, verbose)[0],
+                   verbose, pipelineCacheDir, queueConfig);
+        ownsInstance = true;
+    }
+
+    // Open `physical` on an instance owned by the caller
+    void initDevice(VkInstance sharedInstance, VkPhysicalDevice physical, bool verbose = false,
+                    const std::string& pipelineCacheDir = default_pipeline_cache_dir(),
+                    const QueueConfig& queueConfig = QueueConfig()) {
+        instance = sharedInstance;
+        ownsInstance = false;
+        physicalDevice = physical;
+
+        if (verbose) {
             VkPhysicalDeviceProperties deviceProperties;
             vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
             std::cout << "Selected GPU: " << deviceProperties.deviceName << std::endl;
@@ -60,77 +721,1015 @@ struct VulkanCompute {
                       << VK_API_VERSION_PATCH(deviceProperties.apiVersion) << std::endl;
         }
 
-        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &deviceCount, nullptr);
-        std::vector<VkQueueFamilyProperties> queueFamilies(deviceCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &deviceCount,
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
                                                  queueFamilies.data());
 
-        bool foundCompute = false;
-        for (uint32_t i = 0; i < deviceCount; i++) {
-            if (queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
-                queueFamilyIndex = i;
-                foundCompute = true;
-                if (verbose)
-                    std::cout << "Found compute queue family at index " << queueFamilyIndex
-                              << std::endl;
-                break;
+        queueFamilyIndex = NO_QUEUE_FAMILY;
+        transferFamilyIndex = NO_QUEUE_FAMILY;
+        auto computeRank = [&](uint32_t i) {
+            bool async = !(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT);
+            return 2 * queueFamilies[i].queueCount + (async ? 1 : 0);
+        };
+        for (uint32_t i = 0; i < familyCount; i++) {
+            VkQueueFlags flags = queueFamilies[i].queueFlags;
+            if (flags & VK_QUEUE_COMPUTE_BIT) {
+                if (queueFamilyIndex == NO_QUEUE_FAMILY ||
+                    computeRank(i) > computeRank(queueFamilyIndex)) {
+                    queueFamilyIndex = i;
+                }
+            } else if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) &&
+                       transferFamilyIndex == NO_QUEUE_FAMILY && queueConfig.transferQueue) {
+                transferFamilyIndex = i;
             }
         }
-        if (!foundCompute) {
+        if (queueFamilyIndex == NO_QUEUE_FAMILY) {
             std::cerr << "Failed to find a compute queue family!" << std::endl;
             exit(1);
         }
+        if (verbose) {
+            std::cout << "Found compute queue family at index " << queueFamilyIndex << std::endl;
+        }
+
+        uint32_t computeCount = std::min(queueFamilies[queueFamilyIndex].queueCount,
+                                         std::max(1u, queueConfig.maxComputeQueues));
+        std::vector<float> queuePriorities(computeCount, 1.0f);
+        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(1);
+        queueCreateInfos[0] = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+        queueCreateInfos[0].queueFamilyIndex = queueFamilyIndex;
+        queueCreateInfos[0].queueCount = computeCount;
+        queueCreateInfos[0].pQueuePriorities = queuePriorities.data();
+        if (transferFamilyIndex != NO_QUEUE_FAMILY) {
+            VkDeviceQueueCreateInfo transferCreateInfo = {
+                VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+            transferCreateInfo.queueFamilyIndex = transferFamilyIndex;
+            transferCreateInfo.queueCount = 1;
+            transferCreateInfo.pQueuePriorities = queuePriorities.data();
+            queueCreateInfos.push_back(transferCreateInfo);
+        }
 
-        float queuePriority = 1.0f;
-        VkDeviceQueueCreateInfo queueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
-        queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+        DeviceFeatures features;
+        features.query(physicalDevice);
+        integerDotProduct = features.integerDotProduct;
+        integerDotProductAccelerated = features.integerDotProductAccelerated;
+        cooperativeMatrixNV = features.cooperativeMatrixNV;
+        cooperativeMatrixShapes.clear();
+        if (features.cooperativeMatrix) {
+            cooperativeMatrixShapes =
+                query_cooperative_matrix_shapes(instance, physicalDevice, cooperativeMatrixNV);
+        }
+        if (verbose) {
+            const char* dot = integerDotProductAccelerated ? "accelerated"
+                              : integerDotProduct          ? "emulated"
+                                                           : "no";
+            std::cout << "Integer dot product: " << dot << std::endl;
+            std::cout << "Cooperative matrix fp16 shapes"
+                      << (cooperativeMatrixNV ? " (NV)" : "") << ":";
+            for (const auto& shape : cooperativeMatrixShapes) {
+                std::cout << " " << shape.m << "x" << shape.n << "x" << shape.k;
+            }
+            std::cout << (cooperativeMatrixShapes.empty() ? " none" : "") << std::endl;
+        }
 
         VkDeviceCreateInfo deviceCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
-        deviceCreateInfo.queueCreateInfoCount = 1;
-        deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+        deviceCreateInfo.pNext = features.chain;
+        deviceCreateInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
+        deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
+        deviceCreateInfo.enabledExtensionCount = (uint32_t)features.extensions.size();
+        deviceCreateInfo.ppEnabledExtensionNames = features.extensions.data();
         VK_CHECK(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device));
         if (verbose) std::cout << "Logical Device created." << std::endl;
 
-        vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+        computeQueues.resize(computeCount);
+        for (uint32_t i = 0; i < computeCount; ++i) {
+            vkGetDeviceQueue(device, queueFamilyIndex, i, &computeQueues[i]);
+        }
+        queue = computeQueues[0];
+        nextComputeQueue = 0;
+        transferQueue = VK_NULL_HANDLE;
+        queueFamilyIndices = {queueFamilyIndex};
+        if (transferFamilyIndex != NO_QUEUE_FAMILY) {
+            vkGetDeviceQueue(device, transferFamilyIndex, 0, &transferQueue);
+            queueFamilyIndices.push_back(transferFamilyIndex);
+        }
+        if (verbose) {
+            std::cout << "Compute queues: " << computeCount << ", transfer queue family: ";
+            if (transferQueue == VK_NULL_HANDLE) {
+                std::cout << "none" << std::endl;
+            } else {
+                std::cout << transferFamilyIndex << std::endl;
+            }
+        }
+
+        timestampValidBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+        timestampPeriod = props.limits.timestampPeriod;
+        limits = props.limits;
+
+        subgroupSize = 0;
+        subgroupOperations = 0;
+        if (props.apiVersion >= VK_API_VERSION_1_1) {
+            VkPhysicalDeviceSubgroupProperties subgroupProps = {
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES};
+            VkPhysicalDeviceProperties2 props2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+            props2.pNext = &subgroupProps;
+            vkGetPhysicalDeviceProperties2(physicalDevice, &props2);
+            subgroupSize = subgroupProps.subgroupSize;
+            if (subgroupProps.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) {
+                subgroupOperations = subgroupProps.supportedOperations;
+            }
+        }
+        if (verbose) {
+            std::cout << "Subgroup size: " << subgroupSize << ", operations 0x" << std::hex
+                      << subgroupOperations << std::dec << std::endl;
+        }
+
+        memory.init(physicalDevice, device);
+        unifiedMemory = true;
+        for (uint32_t i = 0; i < memory.memProperties.memoryHeapCount; i++) {
+            if (!(memory.memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+                unifiedMemory = false;
+            }
+        }
+        if (verbose) {
+            std::cout << "Unified memory: " << (unifiedMemory ? "yes" : "no") << std::endl;
+        }
+        if (transferQueue != VK_NULL_HANDLE) {
+            staging.init(device, transferQueue, transferFamilyIndex, memory);
+        } else {
+            staging.init(device, queue, queueFamilyIndex, memory);
+        }
+        createPipelineCache(pipelineCacheDir, verbose);
     }
 
-    VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkDeviceMemory* memory) {
-        VkBuffer buffer;
+    // Seed the pipeline cache from disk. Data whose header names another device or driver is
+    // dropped here rather than handed to the driver.
+    void createPipelineCache(const std::string& dir, bool verbose) {
+        pipelineCachePath = dir.empty() ? "" : pipeline_cache_file(dir, physicalDevice);
+        std::vector<char> data;
+        if (!pipelineCachePath.empty()) {
+            std::ifstream file(pipelineCachePath, std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        VkPipelineCacheHeaderVersionOne header = {};
+        if (data.size() >= sizeof(header)) memcpy(&header, data.data(), sizeof(header));
+        bool valid = data.size() >= sizeof(header) &&
+                     header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                     header.vendorID == props.vendorID && header.deviceID == props.deviceID &&
+                     memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        if (!valid) data.clear();
+        pipelineCacheLoaded = data.size();
+
+        VkPipelineCacheCreateInfo cacheInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.data();
+        VK_CHECK(vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache));
+        if (verbose && !pipelineCachePath.empty()) {
+            std::cout << "Pipeline cache: " << pipelineCachePath << " (" << data.size()
+                      << " bytes loaded)" << std::endl;
+        }
+    }
+
+    // Write the pipeline cache back if it grew. It goes to a temporary file that is then renamed,
+    // so a concurrent run never reads a partial cache. Failing to save only costs the next run.
+    void savePipelineCache() {
+        if (pipelineCachePath.empty()) return;
+        size_t size = 0;
+        VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &size, nullptr));
+        if (size == pipelineCacheLoaded) return;
+        std::vector<char> data(size);
+        VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &size, data.data()));
+
+        std::error_code error;
+        std::filesystem::path path(pipelineCachePath);
+        std::filesystem::create_directories(path.parent_path(), error);
+        std::string tmpPath =
+            pipelineCachePath + "." +
+            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary);
+        file.write(data.data(), size);
+        file.close();
+        if (file) std::filesystem::rename(tmpPath, path, error);
+        if (!file || error) {
+            std::cerr << "Could not save the pipeline cache to " << pipelineCachePath << std::endl;
+            std::filesystem::remove(tmpPath, error);
+        }
+    }
+
+    GpuBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                           VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0) {
+        GpuBuffer buffer;
         VkBufferCreateInfo bufferInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
         bufferInfo.size = size;
         bufferInfo.usage = usage;
+        // Jobs move buffers between compute and transfer queues without ownership transfers
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer));
+        if (queueFamilyIndices.size() > 1) {
+            bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferInfo.queueFamilyIndexCount = (uint32_t)queueFamilyIndices.size();
+            bufferInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+        }
+        VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.buffer));
 
         VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+        vkGetBufferMemoryRequirements(device, buffer.buffer, &memReqs);
+        buffer.allocation = memory.allocate(memReqs, required, preferred);
+        VK_CHECK(vkBindBufferMemory(device, buffer.buffer, buffer.allocation.memory,
+                                    buffer.allocation.offset));
+        buffer.size = size;
+        return buffer;
+    }
 
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    // Device-local storage buffer. On UMA devices it is also host visible and written directly.
+    GpuBuffer createStorageBuffer(VkDeviceSize size) {
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if (unifiedMemory) {
+            return createBuffer(size, usage,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+        return createBuffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    void destroyBuffer(GpuBuffer& buffer) {
+        if (buffer.buffer == VK_NULL_HANDLE) return;
+        vkDestroyBuffer(device, buffer.buffer, nullptr);
+        memory.free(buffer.allocation);
+        buffer = GpuBuffer();
+    }
+
+    void upload(const GpuBuffer& buffer, const void* data, VkDeviceSize size) {
+        if (buffer.allocation.mapped) {
+            memcpy(buffer.allocation.mapped, data, size);
+        } else {
+            staging.upload(buffer.buffer, 0, data, size);
+        }
+    }
+
+    // The caller must have waited for any work writing `buffer`
+    void download(const GpuBuffer& buffer, void* data, VkDeviceSize size) {
+        if (buffer.allocation.mapped) {
+            memcpy(data, buffer.allocation.mapped, size);
+        } else {
+            staging.download(buffer.buffer, 0, data, size);
+        }
+    }
+
+    void cleanup() {
+        savePipelineCache();
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+        staging.destroy(memory);
+        memory.destroy();
+        vkDestroyDevice(device, nullptr);
+        if (ownsInstance) vkDestroyInstance(instance, nullptr);
+    }
+};
+
+// SPIR-V embedded at build time under `filename`, or else read from that file
+inline std::vector<uint> load_spirv(const char* filename) {
+    for (size_t i = 0; i < EMBEDDED_SHADER_COUNT; ++i) {
+        const EmbeddedShader& shader = EMBEDDED_SHADERS[i];
+        if (strcmp(shader.path, filename) == 0) {
+            return std::vector<uint>(shader.code, shader.code + shader.size / sizeof(uint32_t));
+        }
+    }
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("failed to open shader file");
+    size_t fileSize = (size_t)file.tellg();
+    std::vector<uint> buffer(fileSize / 4);
+
+    file.seekg(0);
+    file.read((char*)buffer.data(), fileSize);
+    file.close();
+    return buffer;
+}
+
+// One dispatch of a multi-stage kernel, with its own push constants
+struct VulkanStage {
+    const void* params;
+    size_t params_size;
+    uint32_t gx, gy, gz;
+    uint32_t pipeline = 0;  // 0: the kernel's shader, i: its stage shader i - 1
+};
+
+const uint32_t FRAMES_IN_FLIGHT = 3;
+
+// Per-phase timings of one job in ms. Host phases are wall clock; device phases come from
+// timestamp queries and stay 0 when the queue does not support them.
+struct DispatchProfile {
+    double hostUploadMs = 0.0;    // copying inputs into staging or mapped buffers
+    double hostWaitMs = 0.0;      // submit to fence signalled
+    double hostReadbackMs = 0.0;  // copying the output back to the caller
+    double gpuUploadMs = 0.0;
+    double gpuComputeMs = 0.0;
+    double gpuReadbackMs = 0.0;
+    std::vector<double> gpuStageMs;
+};
+
+struct ComputeKernel;
+
+// Fills `size` bytes of an input at `dst`, its mapped staging or device buffer, in place of the
+// memcpy from a host array. Lets an input be converted on its way in without an extra host copy.
+typedef std::function<void(void* dst, size_t size)> InputWriter;
+
+// Handle to a submitted dispatch. The output is copied to the host pointer given at submit time
+// once the job completes, at the latest when wait() is called.
+struct ComputeJob {
+    ComputeKernel* kernel = nullptr;
+    uint32_t frame = 0;
+    uint64_t serial = 0;
+
+    bool ready() const;
+    void wait() const;
+    // Phase timings, valid after wait() until the kernel reuses the job's frame
+    const DispatchProfile& profile() const;
+};
 
-        uint32_t memoryTypeIndex = uint32_t(-1);
-        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-            if ((memReqs.memoryTypeBits & (1 << i)) &&
-                (memProperties.memoryTypes[i].propertyFlags &
-                 (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))) {
-                memoryTypeIndex = i;
-                break;
+// A compute pipeline built once and dispatched many times. Bindings are the inputs, then scratch
+// buffers, then one output. Up to FRAMES_IN_FLIGHT jobs run concurrently, each in its own frame
+// with its own buffers, descriptor set, command buffer and fence, so uploading job N+1, computing
+// job N and reading back job N-1 overlap. Each submission goes to the device's next compute queue,
+// so consecutive jobs, of this kernel or another, run concurrently. A frame's buffers only grow,
+// and its command buffers are re-recorded only when the stages or buffers change. An input binding
+// may instead be resident: one caller-owned buffer shared by every frame and never uploaded by
+// submit(). Stages may run other shaders over the same bindings and push constants, so a stage
+// whose resources (e.g. shared memory) the others do not need can be built on its own.
+struct ComputeKernel {
+    struct Frame {
+        VkDescriptorSet descriptorSet;
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+
+        // With a dedicated transfer queue, uploads and the readback are separate submissions on
+        // it: uploadCommands signals `uploaded`, commandBuffer waits on it and signals
+        // `computed`, and readbackCommands waits on that and signals the fence.
+        VkCommandBuffer uploadCommands = VK_NULL_HANDLE;
+        VkCommandBuffer readbackCommands = VK_NULL_HANDLE;
+        VkSemaphore uploaded = VK_NULL_HANDLE;
+        VkSemaphore computed = VK_NULL_HANDLE;
+        uint32_t uploadCopies = 0;  // copies recorded in uploadCommands
+
+        std::vector<GpuBuffer> buffers;  // device local, one per binding
+        std::vector<GpuBuffer> uploads;  // host-visible staging, one per input
+        GpuBuffer readback;
+
+        // Dispatch sizes, push constants and copy sizes the command buffer was recorded with
+        std::vector<uint8_t> recordedKey;
+        bool recorded = false;
+
+        bool pending = false;
+        uint64_t serial = 0;
+        void* output = nullptr;
+        size_t outputSize = 0;
+        std::chrono::high_resolution_clock::time_point submitTime;
+        DispatchProfile profile;
+
+        // Timestamps: start, after uploads, after each stage, after readback. Transfer-only queues
+        // cannot reset query pools, so with a dedicated transfer queue all of them are written on
+        // the compute queue and the device upload and readback times read as 0.
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        uint32_t queryCount = 0;
+        uint32_t stageCount = 0;
+    };
+
+    VulkanCompute* vk = nullptr;
+    uint32_t numBindings = 0;
+    uint32_t pushConstantSize = 0;
+    std::vector<bool> resident;  // per binding
+    // Jobs update shared resident state (e.g. buckets carried across chunks): run them all on the
+    // first compute queue, each ordered after the previous job's stages
+    bool inOrder = false;
+
+    std::vector<VkShaderModule> shaderModules;  // the kernel's shader, then its stage shaders
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkPipelineLayout pipelineLayout;
+    std::vector<VkPipeline> pipelines;  // one per shader module
+    VkDescriptorPool descriptorPool;
+    VkCommandPool commandPool;
+    VkCommandPool transferPool = VK_NULL_HANDLE;  // with a dedicated transfer queue
+
+    Frame frames[FRAMES_IN_FLIGHT];
+    uint64_t nextSerial = 1;
+    double setupMs = 0.0;  // shader module, pipeline and per-frame object creation
+
+    // `specialization` fills constant_id 0, 1, ... in order, all 32-bit, in every shader.
+    // `stageShaders` are the shaders of stages with pipeline 1, 2, ...
+    void init(VulkanCompute& vkRef, const char* shaderPath, uint32_t bindings, uint32_t pushSize,
+              const std::vector<uint32_t>& specialization = {},
+              const std::vector<const char*>& stageShaders = {}) {
+        auto start = std::chrono::high_resolution_clock::now();
+        vk = &vkRef;
+        numBindings = bindings;
+        pushConstantSize = pushSize;
+        resident.assign(numBindings, false);
+
+        std::vector<VkDescriptorSetLayoutBinding> layoutBindings(numBindings);
+        for (uint32_t i = 0; i < numBindings; ++i) {
+            layoutBindings[i].binding = i;
+            layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            layoutBindings[i].descriptorCount = 1;
+            layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        layoutInfo.bindingCount = numBindings;
+        layoutInfo.pBindings = layoutBindings.data();
+        VK_CHECK(
+            vkCreateDescriptorSetLayout(vk->device, &layoutInfo, nullptr, &descriptorSetLayout));
+
+        VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        VK_CHECK(
+            vkCreatePipelineLayout(vk->device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+        VkComputePipelineCreateInfo pipelineInfo = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.pName = "main";
+
+        std::vector<VkSpecializationMapEntry> specEntries(specialization.size());
+        for (uint32_t i = 0; i < specialization.size(); ++i) {
+            specEntries[i] = {i, i * uint32_t(sizeof(uint32_t)), sizeof(uint32_t)};
+        }
+        VkSpecializationInfo specInfo = {};
+        specInfo.mapEntryCount = uint32_t(specEntries.size());
+        specInfo.pMapEntries = specEntries.data();
+        specInfo.dataSize = specialization.size() * sizeof(uint32_t);
+        specInfo.pData = specialization.data();
+        if (!specialization.empty()) pipelineInfo.stage.pSpecializationInfo = &specInfo;
+        pipelineInfo.layout = pipelineLayout;
+
+        std::vector<const char*> shaderPaths = {shaderPath};
+        shaderPaths.insert(shaderPaths.end(), stageShaders.begin(), stageShaders.end());
+        shaderModules.resize(shaderPaths.size());
+        pipelines.resize(shaderPaths.size());
+        for (size_t i = 0; i < shaderPaths.size(); ++i) {
+            auto spirv = load_spirv(shaderPaths[i]);
+            VkShaderModuleCreateInfo createInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+            createInfo.codeSize = spirv.size() * 4;
+            createInfo.pCode = spirv.data();
+            VK_CHECK(vkCreateShaderModule(vk->device, &createInfo, nullptr, &shaderModules[i]));
+            pipelineInfo.stage.module = shaderModules[i];
+            VK_CHECK(vkCreateComputePipelines(vk->device, vk->pipelineCache, 1, &pipelineInfo,
+                                              nullptr, &pipelines[i]));
+        }
+
+        VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                         numBindings * FRAMES_IN_FLIGHT};
+        VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        poolInfo.maxSets = FRAMES_IN_FLIGHT;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        VK_CHECK(vkCreateDescriptorPool(vk->device, &poolInfo, nullptr, &descriptorPool));
+
+        auto createCommandPool = [&](uint32_t family) {
+            VkCommandPoolCreateInfo cmdPoolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+            cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            cmdPoolInfo.queueFamilyIndex = family;
+            VkCommandPool pool;
+            VK_CHECK(vkCreateCommandPool(vk->device, &cmdPoolInfo, nullptr, &pool));
+            return pool;
+        };
+        auto allocateCommands = [&](VkCommandPool pool) {
+            VkCommandBufferAllocateInfo cmdBufAllocInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+            cmdBufAllocInfo.commandPool = pool;
+            cmdBufAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            cmdBufAllocInfo.commandBufferCount = 1;
+            VkCommandBuffer commands;
+            VK_CHECK(vkAllocateCommandBuffers(vk->device, &cmdBufAllocInfo, &commands));
+            return commands;
+        };
+
+        commandPool = createCommandPool(vk->queueFamilyIndex);
+        if (splitTransfers()) transferPool = createCommandPool(vk->transferFamilyIndex);
+
+        for (Frame& frame : frames) {
+            VkDescriptorSetAllocateInfo allocInfo = {
+                VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+            allocInfo.descriptorPool = descriptorPool;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &descriptorSetLayout;
+            VK_CHECK(vkAllocateDescriptorSets(vk->device, &allocInfo, &frame.descriptorSet));
+
+            frame.commandBuffer = allocateCommands(commandPool);
+
+            VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+            VK_CHECK(vkCreateFence(vk->device, &fenceInfo, nullptr, &frame.fence));
+
+            if (splitTransfers()) {
+                frame.uploadCommands = allocateCommands(transferPool);
+                frame.readbackCommands = allocateCommands(transferPool);
+                VkSemaphoreCreateInfo semaphoreInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+                VK_CHECK(vkCreateSemaphore(vk->device, &semaphoreInfo, nullptr, &frame.uploaded));
+                VK_CHECK(vkCreateSemaphore(vk->device, &semaphoreInfo, nullptr, &frame.computed));
             }
+
+            frame.buffers.assign(numBindings, GpuBuffer());
         }
+        auto end = std::chrono::high_resolution_clock::now();
+        setupMs = std::chrono::duration<double, std::milli>(end - start).count();
+    }
 
-        VkMemoryAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = memoryTypeIndex;
-        VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, memory));
-        VK_CHECK(vkBindBufferMemory(device, buffer, *memory, 0));
+    // Copies go through the transfer queue; on UMA devices there are none
+    bool splitTransfers() const {
+        return vk->transferQueue != VK_NULL_HANDLE && !vk->unifiedMemory;
+    }
 
-        return buffer;
+    void writeDescriptor(Frame& frame, uint32_t binding) {
+        VkDescriptorBufferInfo bufferInfo = {frame.buffers[binding].buffer, 0, VK_WHOLE_SIZE};
+        VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        write.dstSet = frame.descriptorSet;
+        write.dstBinding = binding;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(vk->device, 1, &write, 0, nullptr);
+        frame.recorded = false;
+    }
+
+    // Ensure the frame's buffer at `binding` holds at least `size` bytes. Growing drops its
+    // contents and invalidates the recorded command buffer.
+    void reserve(Frame& frame, uint32_t binding, VkDeviceSize size) {
+        if (resident[binding] || frame.buffers[binding].size >= size) return;
+        vk->destroyBuffer(frame.buffers[binding]);
+        frame.buffers[binding] = vk->createStorageBuffer(size);
+        writeDescriptor(frame, binding);
+    }
+
+    // Bind `buffer` at input `binding` in every frame. submit() then skips that input (pass a null
+    // pointer); the caller keeps it alive and unchanged while jobs are in flight, and frees it.
+    void bindResident(uint32_t binding, const GpuBuffer& buffer) {
+        for (Frame& frame : frames) {
+            complete(frame);
+            if (!resident[binding]) vk->destroyBuffer(frame.buffers[binding]);
+            frame.buffers[binding] = buffer;
+            writeDescriptor(frame, binding);
+        }
+        resident[binding] = true;
+    }
+
+    void reserveStaging(GpuBuffer& buffer, VkDeviceSize size, Frame& frame) {
+        if (buffer.size >= size) return;
+        vk->destroyBuffer(buffer);
+        buffer = vk->createBuffer(
+            size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        frame.recorded = false;
+    }
+
+    // Wait for the frame's job, if any, and copy its output to the host
+    void complete(Frame& frame) {
+        if (!frame.pending) return;
+        VK_CHECK(vkWaitForFences(vk->device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+        auto end = std::chrono::high_resolution_clock::now();
+        frame.profile.hostWaitMs =
+            std::chrono::duration<double, std::milli>(end - frame.submitTime).count();
+        VK_CHECK(vkResetFences(vk->device, 1, &frame.fence));
+
+        auto start = std::chrono::high_resolution_clock::now();
+        const GpuBuffer& src = vk->unifiedMemory ? frame.buffers.back() : frame.readback;
+        memcpy(frame.output, src.allocation.mapped, frame.outputSize);
+        end = std::chrono::high_resolution_clock::now();
+        frame.profile.hostReadbackMs =
+            std::chrono::duration<double, std::milli>(end - start).count();
+
+        if (frame.queryPool != VK_NULL_HANDLE) readTimestamps(frame);
+        frame.pending = false;
+    }
+
+    void readTimestamps(Frame& frame) {
+        uint32_t count = frame.stageCount + 3;
+        std::vector<uint64_t> ticks(count);
+        VK_CHECK(vkGetQueryPoolResults(vk->device, frame.queryPool, 0, count,
+                                       count * sizeof(uint64_t), ticks.data(), sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        uint64_t mask = vk->timestampValidBits >= 64 ? ~0ull : (1ull << vk->timestampValidBits) - 1;
+        auto ms = [&](uint32_t from, uint32_t to) {
+            return double((ticks[to] - ticks[from]) & mask) * vk->timestampPeriod / 1e6;
+        };
+
+        DispatchProfile& profile = frame.profile;
+        profile.gpuUploadMs = ms(0, 1);
+        profile.gpuComputeMs = ms(1, frame.stageCount + 1);
+        profile.gpuReadbackMs = ms(frame.stageCount + 1, frame.stageCount + 2);
+        profile.gpuStageMs.resize(frame.stageCount);
+        for (uint32_t i = 0; i < frame.stageCount; ++i) profile.gpuStageMs[i] = ms(i + 1, i + 2);
+    }
+
+    void reserveQueries(Frame& frame, uint32_t count) {
+        if (frame.queryCount >= count) return;
+        if (frame.queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(vk->device, frame.queryPool, nullptr);
+        }
+        VkQueryPoolCreateInfo queryPoolInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = count;
+        VK_CHECK(vkCreateQueryPool(vk->device, &queryPoolInfo, nullptr, &frame.queryPool));
+        frame.queryCount = count;
+    }
+
+    void record(Frame& frame, const std::vector<VulkanStage>& stages,
+                const std::vector<size_t>& inputSizes) {
+        std::vector<uint8_t> key;
+        for (const auto& stage : stages) {
+            const uint8_t* dims = reinterpret_cast<const uint8_t*>(&stage.gx);
+            key.insert(key.end(), dims, dims + 4 * sizeof(uint32_t));  // gx, gy, gz, pipeline
+            const uint8_t* params = static_cast<const uint8_t*>(stage.params);
+            key.insert(key.end(), params, params + stage.params_size);
+        }
+        const uint8_t* sizes = reinterpret_cast<const uint8_t*>(inputSizes.data());
+        key.insert(key.end(), sizes, sizes + inputSizes.size() * sizeof(size_t));
+        const uint8_t* outputSize = reinterpret_cast<const uint8_t*>(&frame.outputSize);
+        key.insert(key.end(), outputSize, outputSize + sizeof(size_t));
+        if (frame.recorded && key == frame.recordedKey) return;
+
+        bool timestamps = vk->timestampValidBits > 0;
+        frame.stageCount = stages.size();
+        if (timestamps) reserveQueries(frame, frame.stageCount + 3);
+        auto timestamp = [&](VkCommandBuffer cmd, uint32_t query) {
+            if (timestamps) {
+                vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool,
+                                    query);
+            }
+        };
+
+        bool split = splitTransfers();
+        VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        auto recordUploads = [&](VkCommandBuffer commands) {
+            frame.uploadCopies = 0;
+            if (vk->unifiedMemory) return;
+            for (size_t i = 0; i < inputSizes.size(); ++i) {
+                if (resident[i]) continue;
+                VkBufferCopy region = {0, 0, inputSizes[i]};
+                vkCmdCopyBuffer(commands, frame.uploads[i].buffer, frame.buffers[i].buffer, 1,
+                                &region);
+                ++frame.uploadCopies;
+            }
+        };
+        auto recordReadback = [&](VkCommandBuffer commands) {
+            VkBufferCopy region = {0, 0, frame.outputSize};
+            vkCmdCopyBuffer(commands, frame.buffers.back().buffer, frame.readback.buffer, 1,
+                            &region);
+            VkMemoryBarrier hostBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+            hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0,
+                                 nullptr);
+        };
+
+        if (split) {
+            VK_CHECK(vkResetCommandBuffer(frame.uploadCommands, 0));
+            VK_CHECK(vkBeginCommandBuffer(frame.uploadCommands, &beginInfo));
+            recordUploads(frame.uploadCommands);
+            VK_CHECK(vkEndCommandBuffer(frame.uploadCommands));
+        }
+
+        VkCommandBuffer cmd = frame.commandBuffer;
+        VK_CHECK(vkResetCommandBuffer(cmd, 0));
+        VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+        if (timestamps) {
+            vkCmdResetQueryPool(cmd, frame.queryPool, 0, frame.queryCount);
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, 0);
+        }
+        if (!split) recordUploads(cmd);
+        timestamp(cmd, 1);
+
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
+                                &frame.descriptorSet, 0, nullptr);
+
+        // Uploads (copied above, or written through a host mapping) land before the first stage,
+        // and so do earlier in-order jobs
+        VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        VkPipelineStageFlags srcStages =
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT;
+        if (inOrder) {
+            barrier.srcAccessMask |= VK_ACCESS_SHADER_WRITE_BIT;
+            srcStages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        }
+        vkCmdPipelineBarrier(cmd, srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                             0, nullptr, 0, nullptr);
+        for (size_t i = 0; i < stages.size(); ++i) {
+            if (i > 0) {
+                barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0,
+                                     nullptr, 0, nullptr);
+            }
+            if (i == 0 || stages[i].pipeline != stages[i - 1].pipeline) {
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                  pipelines[stages[i].pipeline]);
+            }
+            vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                               (uint32_t)stages[i].params_size, stages[i].params);
+            vkCmdDispatch(cmd, stages[i].gx, stages[i].gy, stages[i].gz);
+            timestamp(cmd, i + 2);
+        }
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+        if (!vk->unifiedMemory && !split) recordReadback(cmd);
+        timestamp(cmd, frame.stageCount + 2);
+        VK_CHECK(vkEndCommandBuffer(cmd));
+
+        if (split) {
+            VK_CHECK(vkResetCommandBuffer(frame.readbackCommands, 0));
+            VK_CHECK(vkBeginCommandBuffer(frame.readbackCommands, &beginInfo));
+            recordReadback(frame.readbackCommands);
+            VK_CHECK(vkEndCommandBuffer(frame.readbackCommands));
+        }
+
+        frame.recordedKey = key;
+        frame.recorded = true;
+    }
+
+    // Queue one job and return without waiting for it. Inputs are copied before returning, so the
+    // host arrays may be reused at once; `output` must stay valid until the job completes. Blocks
+    // only when all frames are busy, completing the oldest job. An input with a writer in
+    // `writers` is written by it instead (pass a null pointer), within the timed host upload.
+    ComputeJob submit(const std::vector<VulkanStage>& stages, const std::vector<void*>& inputs,
+                      const std::vector<size_t>& inputSizes,
+                      const std::vector<size_t>& scratchSizes, void* output, size_t outputSize,
+                      const std::vector<InputWriter>& writers = {}) {
+        uint64_t serial = nextSerial++;
+        uint32_t index = serial % FRAMES_IN_FLIGHT;
+        Frame& frame = frames[index];
+        complete(frame);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        frame.uploads.resize(inputs.size());
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (resident[i]) continue;
+            reserve(frame, i, inputSizes[i]);
+            void* dst = frame.buffers[i].allocation.mapped;
+            if (!vk->unifiedMemory) {
+                reserveStaging(frame.uploads[i], inputSizes[i], frame);
+                dst = frame.uploads[i].allocation.mapped;
+            }
+            if (i < writers.size() && writers[i]) {
+                writers[i](dst, inputSizes[i]);
+            } else {
+                memcpy(dst, inputs[i], inputSizes[i]);
+            }
+        }
+        for (size_t i = 0; i < scratchSizes.size(); ++i) {
+            reserve(frame, inputs.size() + i, scratchSizes[i]);
+        }
+        reserve(frame, numBindings - 1, outputSize);
+        if (!vk->unifiedMemory) reserveStaging(frame.readback, outputSize, frame);
+        auto end = std::chrono::high_resolution_clock::now();
+        frame.profile = DispatchProfile();
+        frame.profile.hostUploadMs =
+            std::chrono::duration<double, std::milli>(end - start).count();
+
+        frame.output = output;
+        frame.outputSize = outputSize;
+        record(frame, stages, inputSizes);
+
+        VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &frame.commandBuffer;
+        VkQueue queue = vk->computeQueues[0];
+        if (!inOrder) {
+            queue = vk->computeQueues[vk->nextComputeQueue];
+            vk->nextComputeQueue = (vk->nextComputeQueue + 1) % vk->computeQueues.size();
+        }
+        frame.submitTime = std::chrono::high_resolution_clock::now();
+        if (splitTransfers()) {
+            submitSplit(frame, queue, submitInfo);
+        } else {
+            VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, frame.fence));
+        }
+        frame.pending = true;
+        frame.serial = serial;
+
+        ComputeJob job;
+        job.kernel = this;
+        job.frame = index;
+        job.serial = serial;
+        return job;
+    }
+
+    // Upload on the transfer queue, compute on `queue`, read back on the transfer queue
+    void submitSplit(Frame& frame, VkQueue queue, VkSubmitInfo& computeInfo) {
+        if (frame.uploadCopies > 0) {
+            VkSubmitInfo uploadInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+            uploadInfo.commandBufferCount = 1;
+            uploadInfo.pCommandBuffers = &frame.uploadCommands;
+            uploadInfo.signalSemaphoreCount = 1;
+            uploadInfo.pSignalSemaphores = &frame.uploaded;
+            VK_CHECK(vkQueueSubmit(vk->transferQueue, 1, &uploadInfo, VK_NULL_HANDLE));
+        }
+
+        // Nothing in the compute submission, timestamps included, starts before the uploads land
+        VkPipelineStageFlags computeWait = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        if (frame.uploadCopies > 0) {
+            computeInfo.waitSemaphoreCount = 1;
+            computeInfo.pWaitSemaphores = &frame.uploaded;
+            computeInfo.pWaitDstStageMask = &computeWait;
+        }
+        computeInfo.signalSemaphoreCount = 1;
+        computeInfo.pSignalSemaphores = &frame.computed;
+        VK_CHECK(vkQueueSubmit(queue, 1, &computeInfo, VK_NULL_HANDLE));
+
+        VkPipelineStageFlags readbackWait = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo readbackInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        readbackInfo.waitSemaphoreCount = 1;
+        readbackInfo.pWaitSemaphores = &frame.computed;
+        readbackInfo.pWaitDstStageMask = &readbackWait;
+        readbackInfo.commandBufferCount = 1;
+        readbackInfo.pCommandBuffers = &frame.readbackCommands;
+        VK_CHECK(vkQueueSubmit(vk->transferQueue, 1, &readbackInfo, frame.fence));
+    }
+
+    // Synchronous dispatch
+    DispatchProfile dispatch(const std::vector<VulkanStage>& stages,
+                             const std::vector<void*>& inputs,
+                             const std::vector<size_t>& inputSizes,
+                             const std::vector<size_t>& scratchSizes, void* output,
+                             size_t outputSize) {
+        ComputeJob job = submit(stages, inputs, inputSizes, scratchSizes, output, outputSize);
+        job.wait();
+        return frames[job.frame].profile;
+    }
+
+    void destroy() {
+        for (Frame& frame : frames) {
+            complete(frame);
+            vkDestroyFence(vk->device, frame.fence, nullptr);
+            if (frame.queryPool != VK_NULL_HANDLE) {
+                vkDestroyQueryPool(vk->device, frame.queryPool, nullptr);
+            }
+            for (uint32_t i = 0; i < numBindings; ++i) {
+                if (!resident[i]) vk->destroyBuffer(frame.buffers[i]);
+            }
+            for (auto& b : frame.uploads) vk->destroyBuffer(b);
+            vk->destroyBuffer(frame.readback);
+            if (frame.uploaded != VK_NULL_HANDLE) {
+                vkDestroySemaphore(vk->device, frame.uploaded, nullptr);
+                vkDestroySemaphore(vk->device, frame.computed, nullptr);
+            }
+        }
+        vkDestroyCommandPool(vk->device, commandPool, nullptr);
+        if (transferPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(vk->device, transferPool, nullptr);
+        }
+        vkDestroyDescriptorPool(vk->device, descriptorPool, nullptr);
+        for (VkPipeline pipeline : pipelines) vkDestroyPipeline(vk->device, pipeline, nullptr);
+        vkDestroyPipelineLayout(vk->device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(vk->device, descriptorSetLayout, nullptr);
+        for (VkShaderModule module : shaderModules) {
+            vkDestroyShaderModule(vk->device, module, nullptr);
+        }
+    }
+};
+
+inline bool ComputeJob::ready() const {
+    const ComputeKernel::Frame& f = kernel->frames[frame];
+    if (f.serial != serial || !f.pending) return true;
+    return vkGetFenceStatus(kernel->vk->device, f.fence) == VK_SUCCESS;
+}
+
+// A job whose frame has been reused was completed before the reuse
+inline void ComputeJob::wait() const {
+    ComputeKernel::Frame& f = kernel->frames[frame];
+    if (f.serial == serial) kernel->complete(f);
+}
+
+inline const DispatchProfile& ComputeJob::profile() const {
+    return kernel->frames[frame].profile;
+}
+
+// A kernel variant: the shader with one set of specialization constants, and the shaders of any
+// stages built on their own (see ComputeKernel::init)
+struct KernelSpec {
+    const char* shaderPath;
+    uint32_t numBindings;
+    uint32_t pushConstantSize;
+    std::vector<uint32_t> specialization;
+    std::vector<const char*> stageShaders = {};
+};
+
+// Kernels keyed by shader path and specialization constants, created on first use (or by
+// warmUp) and kept until destroy()
+struct KernelCache {
+    VulkanCompute* vk = nullptr;
+    std::map<std::string, ComputeKernel> kernels;
+
+    void init(VulkanCompute& vkRef) {
+        vk = &vkRef;
+    }
+
+    static std::string key(const char* shaderPath, const std::vector<uint32_t>& specialization,
+                           const std::vector<const char*>& stageShaders = {}) {
+        std::string key = shaderPath;
+        for (uint32_t value : specialization) key += ":" + std::to_string(value);
+        for (const char* stageShader : stageShaders) key += "+" + std::string(stageShader);
+        return key;
+    }
+
+    ComputeKernel& get(const char* shaderPath, uint32_t numBindings, uint32_t pushConstantSize,
+                       const std::vector<uint32_t>& specialization = {},
+                       const std::vector<const char*>& stageShaders = {}) {
+        std::string name = key(shaderPath, specialization, stageShaders);
+        auto it = kernels.find(name);
+        if (it != kernels.end()) return it->second;
+        ComputeKernel& kernel = kernels[name];
+        kernel.init(*vk, shaderPath, numBindings, pushConstantSize, specialization, stageShaders);
+        return kernel;
+    }
+
+    ComputeKernel& get(const KernelSpec& spec) {
+        return get(spec.shaderPath, spec.numBindings, spec.pushConstantSize, spec.specialization,
+                   spec.stageShaders);
+    }
+
+    // Create every kernel in `specs` not created yet, compiling their pipelines on parallel
+    // threads. Returns the number created.
+    size_t warmUp(const std::vector<KernelSpec>& specs) {
+        std::vector<std::pair<const KernelSpec*, ComputeKernel*>> pending;
+        for (const KernelSpec& spec : specs) {
+            std::string name = key(spec.shaderPath, spec.specialization, spec.stageShaders);
+            if (kernels.count(name)) continue;
+            pending.push_back({&spec, &kernels[name]});
+        }
+        // Map entries stay put while others are inserted, and Vulkan object creation and the
+        // pipeline cache are thread safe, so only the map itself needs filling up front
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < (int)pending.size(); ++i) {
+            const KernelSpec& spec = *pending[i].first;
+            pending[i].second->init(*vk, spec.shaderPath, spec.numBindings, spec.pushConstantSize,
+                                    spec.specialization, spec.stageShaders);
+        }
+        return pending.size();
+    }
+
+    void destroy() {
+        for (auto& entry : kernels) entry.second.destroy();
+        kernels.clear();
+    }
+};
+
+// Several logical devices on one instance, each with its own kernels, for sharding one problem
+// across GPUs
+struct DeviceGroup {
+    VkInstance instance = VK_NULL_HANDLE;
+    std::vector<VulkanCompute> devices;
+    std::vector<KernelCache> kernels;  // kernels[i] runs on devices[i]
+
+    // Open `count` devices on the physical devices matching `selector`, best first; 0 opens every
+    // match once. With fewer matches than `count` they are reused round robin, each use a separate
+    // VkDevice, so a single device (e.g. lavapipe) can stand in for several.
+    void init(const DeviceSelector& selector, uint32_t count, bool verbose = false,
+              const std::string& pipelineCacheDir = default_pipeline_cache_dir(),
+              const QueueConfig& queueConfig = QueueConfig()) {
+        instance = create_instance(verbose);
+        std::vector<VkPhysicalDevice> matches =
+            select_physical_devices(instance, selector, verbose);
+        if (count == 0) count = (uint32_t)matches.size();
+
+        // Both vectors are sized once: the kernel caches keep pointers to the devices
+        devices.resize(count);
+        kernels.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            devices[i].initDevice(instance, matches[i % matches.size()], verbose,
+                                  pipelineCacheDir, queueConfig);
+            kernels[i].init(devices[i]);
+        }
     }
 
     void cleanup() {
-        vkDestroyDevice(device, nullptr);
+        for (auto& cache : kernels) cache.destroy();
+        for (auto& device : devices) device.cleanup();
+        kernels.clear();
+        devices.clear();
         vkDestroyInstance(instance, nullptr);
+        instance = VK_NULL_HANDLE;
     }
 };
+
+#endif  // VULKAN_HELPER_H